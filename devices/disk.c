@@ -7,6 +7,10 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+/* My Implementation */
+#include <list.h>
+#include "threads/thread.h"
+/* == My Implementation */
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -32,6 +36,9 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+/* My Implementation */
+#define STA_ERR 0x01            /* Error. */
+/* == My Implementation */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +54,15 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+/* My Implementation */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+/* Most sectors one command can move, a sector count of 0 means
+   256. */
+#define MAX_XFER_SECTORS 256
+/* == My Implementation */
 
 /* An ATA device. */
 struct disk 
@@ -57,6 +73,10 @@ struct disk
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+    /* My Implementation */
+    int multiple;               /* Sectors per interrupt of READ/WRITE
+                                   MULTIPLE, 0 if not supported. */
+    /* == My Implementation */
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
@@ -75,6 +95,21 @@ struct channel
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    /* My Implementation */
+    /* Only the channel's I/O thread accesses the controller after
+       disk_init(), the lock protects the queue. */
+    struct list queue;          /* Pending requests, by device and sector. */
+    struct semaphore queue_sema; /* Up'd for each submitted request. */
+    int head_dev;               /* Where the last batch ended, */
+    disk_sector_t head_sector;  /* for the elevator. */
+    size_t queued;              /* Number of requests in QUEUE. */
+
+    /* Statistics. */
+    long long request_cnt;      /* Number of requests served. */
+    long long command_cnt;      /* Number of commands issued for them. */
+    size_t max_queued;          /* Most requests queued at once. */
+    /* == My Implementation */
+
     struct disk devices[2];     /* The devices on this channel. */
   };
 
@@ -86,10 +121,20 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+/* Old Implementation
+static void select_sector (struct disk *, disk_sector_t); */
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+/* My Implementation */
+static void set_multiple_mode (struct disk *, int multiple);
+static void select_sectors (struct disk *, disk_sector_t, size_t cnt);
+static size_t block_sectors (const struct disk *, size_t left);
+static list_less_func request_less;
+static thread_func channel_thread NO_RETURN;
+static void take_batch (struct channel *, struct list *batch);
+static void do_batch (struct channel *, struct list *batch);
+/* == My Implementation */
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
@@ -127,6 +172,15 @@ disk_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      /* My Implementation */
+      list_init (&c->queue);
+      sema_init (&c->queue_sema, 0);
+      c->head_dev = 0;
+      c->head_sector = 0;
+      c->queued = 0;
+      c->request_cnt = c->command_cnt = 0;
+      c->max_queued = 0;
+      /* == My Implementation */
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -138,6 +192,9 @@ disk_init (void)
 
           d->is_ata = false;
           d->capacity = 0;
+          /* My Implementation */
+          d->multiple = 0;
+          /* == My Implementation */
 
           d->read_cnt = d->write_cnt = 0;
         }
@@ -156,6 +213,11 @@ disk_init (void)
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
           identify_ata_device (&c->devices[dev_no]);
+
+      /* My Implementation */
+      /* From now on only this thread issues commands. */
+      thread_create (c->name, PRI_MAX, channel_thread, c);
+      /* == My Implementation */
     }
 }
 
@@ -176,6 +238,15 @@ disk_print_stats (void)
             printf ("%s: %lld reads, %lld writes\n",
                     d->name, d->read_cnt, d->write_cnt);
         }
+
+      /* My Implementation */
+      {
+        struct channel *c = &channels[chan_no];
+        if (c->request_cnt > 0)
+          printf ("%s: %lld requests in %lld commands, up to %zu queued\n",
+                  c->name, c->request_cnt, c->command_cnt, c->max_queued);
+      }
+      /* == My Implementation */
     }
 }
 
@@ -219,6 +290,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
+  /* Old Implementation
   struct channel *c;
   
   ASSERT (d != NULL);
@@ -233,7 +305,10 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
     PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
   input_sector (c, buffer);
   d->read_cnt++;
-  lock_release (&c->lock);
+  lock_release (&c->lock); */
+  /* My Implementation */
+  disk_read_multiple (d, sec_no, buffer, 1);
+  /* == My Implementation */
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -244,6 +319,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
+  /* Old Implementation
   struct channel *c;
   
   ASSERT (d != NULL);
@@ -258,9 +334,281 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
   output_sector (c, buffer);
   sema_down (&c->completion_wait);
   d->write_cnt++;
+  lock_release (&c->lock); */
+  /* My Implementation */
+  disk_write_multiple (d, sec_no, buffer, 1);
+  /* == My Implementation */
+}
+
+/* My Implementation */
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * DISK_SECTOR_SIZE bytes,
+   and waits for them. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+                    size_t cnt)
+{
+  struct disk_request r;
+
+  if (cnt == 0)
+    return;
+  disk_request_init (&r, d, sec_no, buffer, cnt, false);
+  disk_submit (&r);
+  disk_wait (&r);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+                     const void *buffer, size_t cnt)
+{
+  struct disk_request r;
+
+  if (cnt == 0)
+    return;
+  disk_request_init (&r, d, sec_no, (void *) buffer, cnt, true);
+  disk_submit (&r);
+  disk_wait (&r);
+}
+
+/* Initializes R to read, or write if WRITE, the CNT sectors
+   starting at SEC_NO of disk D from or into BUFFER.  The caller
+   may set R's done and aux members before submitting it. */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+                   disk_sector_t sec_no, void *buffer, size_t cnt,
+                   bool write)
+{
+  ASSERT (d != NULL);
+  ASSERT (buffer != NULL);
+
+  r->disk = d;
+  r->sector = sec_no;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->done = NULL;
+  r->aux = NULL;
+  sema_init (&r->finished, 0);
+}
+
+/* Queues R on the channel of its disk and returns at once.  R and
+   its buffer must stay valid until it is finished: then R's done
+   function is called by the channel's I/O thread if it has one,
+   otherwise disk_wait() returns. */
+void
+disk_submit (struct disk_request *r)
+{
+  struct channel *c = r->disk->channel;
+
+  ASSERT (r->cnt > 0);
+  ASSERT (r->sector + r->cnt <= r->disk->capacity);
+
+  lock_acquire (&c->lock);
+  list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+  if (++c->queued > c->max_queued)
+    c->max_queued = c->queued;
   lock_release (&c->lock);
+  sema_up (&c->queue_sema);
 }
-
+
+/* Waits until R, which has no done function, is finished. */
+void
+disk_wait (struct disk_request *r)
+{
+  ASSERT (r->done == NULL);
+
+  sema_down (&r->finished);
+}
+
+/* Orders requests by device, then sector.  A request goes after
+   the equal ones, so requests for a sector are served in the
+   order they came. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED)
+{
+  const struct disk_request *a = list_entry (a_, struct disk_request, elem);
+  const struct disk_request *b = list_entry (b_, struct disk_request, elem);
+
+  if (a->disk->dev_no != b->disk->dev_no)
+    return a->disk->dev_no < b->disk->dev_no;
+  return a->sector < b->sector;
+}
+
+/* Serves the requests queued on channel C, which is passed as
+   AUX, one batch at a time. */
+static void
+channel_thread (void *aux)
+{
+  struct channel *c = aux;
+  struct list batch;
+
+  for (;;)
+    {
+      sema_down (&c->queue_sema);
+
+      /* Requests merged into an earlier batch left their ups
+         behind. */
+      lock_acquire (&c->lock);
+      list_init (&batch);
+      if (!list_empty (&c->queue))
+        take_batch (c, &batch);
+      lock_release (&c->lock);
+
+      if (!list_empty (&batch))
+        {
+          do_batch (c, &batch);
+          while (!list_empty (&batch))
+            {
+              struct disk_request *r = list_entry (list_pop_front (&batch),
+                                                   struct disk_request, elem);
+              if (r->done != NULL)
+                r->done (r);
+              else
+                sema_up (&r->finished);
+            }
+        }
+    }
+}
+
+/* Moves the next requests of channel C's queue into BATCH, with
+   the C-LOOK elevator: the first request at or after the position
+   where the last batch ended, or the lowest one if there is none,
+   and the requests right after it that continue it, as long as
+   one command can move them all.  C's lock must be held. */
+static void
+take_batch (struct channel *c, struct list *batch)
+{
+  struct disk_request *first, *r;
+  struct list_elem *e, *next;
+  disk_sector_t end;
+  size_t cnt;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+  ASSERT (!list_empty (&c->queue));
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      r = list_entry (e, struct disk_request, elem);
+      if (r->disk->dev_no > c->head_dev
+          || (r->disk->dev_no == c->head_dev && r->sector >= c->head_sector))
+        break;
+    }
+  if (e == list_end (&c->queue))
+    e = list_begin (&c->queue);
+
+  first = list_entry (e, struct disk_request, elem);
+  end = first->sector + first->cnt;
+  cnt = first->cnt;
+  for (;;)
+    {
+      next = list_next (e);
+      list_remove (e);
+      list_push_back (batch, e);
+      c->queued--;
+      c->request_cnt++;
+      if (next == list_end (&c->queue))
+        break;
+
+      r = list_entry (next, struct disk_request, elem);
+      if (r->disk != first->disk || r->write != first->write
+          || r->sector != end || cnt + r->cnt > MAX_XFER_SECTORS)
+        break;
+      end += r->cnt;
+      cnt += r->cnt;
+      e = next;
+    }
+
+  c->head_dev = first->disk->dev_no;
+  c->head_sector = end;
+}
+
+/* Carries out BATCH, requests of the same kind on one disk for
+   consecutive sectors, with as few commands as possible.  Each
+   command moves up to MAX_XFER_SECTORS sectors, with an interrupt
+   per READ/WRITE MULTIPLE block instead of per sector if the disk
+   supports it. */
+static void
+do_batch (struct channel *c, struct list *batch)
+{
+  struct disk_request *first, *r;
+  struct disk *d;
+  disk_sector_t sec_no;
+  size_t total, xfer, block, done, i, j, ofs;
+  struct list_elem *e;
+  bool write;
+
+  first = list_entry (list_front (batch), struct disk_request, elem);
+  d = first->disk;
+  write = first->write;
+  total = 0;
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    total += list_entry (e, struct disk_request, elem)->cnt;
+
+  /* R and OFS walk through the sectors of the batch */
+  r = first;
+  ofs = 0;
+  for (done = 0; done < total; done += xfer)
+    {
+      sec_no = first->sector + done;
+      xfer = total - done < MAX_XFER_SECTORS ? total - done : MAX_XFER_SECTORS;
+      select_sectors (d, sec_no, xfer);
+      c->command_cnt++;
+      if (write)
+        issue_pio_command (c, d->multiple > 0 ? CMD_WRITE_MULTIPLE
+                                              : CMD_WRITE_SECTOR_RETRY);
+      else
+        issue_pio_command (c, d->multiple > 0 ? CMD_READ_MULTIPLE
+                                              : CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < xfer; i += block)
+        {
+          block = block_sectors (d, xfer - i);
+          if (!write)
+            sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+                   d->name, write ? "write" : "read", sec_no + i);
+          for (j = 0; j < block; j++)
+            {
+              if (ofs == r->cnt)
+                {
+                  r = list_entry (list_next (&r->elem),
+                                  struct disk_request, elem);
+                  ofs = 0;
+                }
+              if (write)
+                output_sector (c, (uint8_t *) r->buffer
+                                  + ofs * DISK_SECTOR_SIZE);
+              else
+                input_sector (c, (uint8_t *) r->buffer
+                                 + ofs * DISK_SECTOR_SIZE);
+              ofs++;
+            }
+          if (write)
+            sema_down (&c->completion_wait);
+        }
+      if (write)
+        d->write_cnt += xfer;
+      else
+        d->read_cnt += xfer;
+    }
+}
+
+/* Returns the number of sectors moved by the next data block of
+   a command on disk D with LEFT sectors left. */
+static size_t
+block_sectors (const struct disk *d, size_t left)
+{
+  if (d->multiple == 0)
+    return 1;
+  return left < (size_t) d->multiple ? left : (size_t) d->multiple;
+}
+/* == My Implementation */
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -386,6 +734,12 @@ identify_ata_device (struct disk *d)
   /* Calculate capacity. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+  /* My Implementation */
+  /* Largest READ/WRITE MULTIPLE block the disk supports. */
+  if ((id[47] & 0xff) > 0)
+    set_multiple_mode (d, id[47] & 0xff);
+  /* == My Implementation */
+
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
   if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -404,6 +758,24 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* My Implementation */
+/* Sends a SET MULTIPLE MODE command to disk D so that READ/WRITE
+   MULTIPLE move MULTIPLE sectors per interrupt, and records the
+   result in D's multiple member. */
+static void
+set_multiple_mode (struct disk *d, int multiple)
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), multiple);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  d->multiple = inb (reg_alt_status (c)) & STA_ERR ? 0 : multiple;
+}
+/* == My Implementation */
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -425,9 +797,10 @@ print_ata_string (char *string, size_t size)
     printf ("%c", string[i ^ 1]);
 }
 
-/* Selects device D, waiting for it to become ready, and then
+/* Old Implementation
+   Selects device D, waiting for it to become ready, and then
    writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   use LBA mode.)
 static void
 select_sector (struct disk *d, disk_sector_t sec_no) 
 {
@@ -443,7 +816,29 @@ select_sector (struct disk *d, disk_sector_t sec_no)
   outb (reg_lbah (c), (sec_no >> 16));
   outb (reg_device (c),
         DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+} */
+
+/* My Implementation */
+/* As select_sector(), but for the CNT sectors starting at SEC_NO,
+   at most MAX_XFER_SECTORS. */
+static void
+select_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt) 
+{
+  struct channel *c = d->channel;
+
+  ASSERT (cnt > 0 && cnt <= MAX_XFER_SECTORS);
+  ASSERT (sec_no + cnt <= d->capacity);
+  ASSERT (sec_no + cnt <= (1UL << 28));
+  
+  select_device_wait (d);
+  outb (reg_nsect (c), cnt == MAX_XFER_SECTORS ? 0 : cnt);
+  outb (reg_lbal (c), sec_no);
+  outb (reg_lbam (c), sec_no >> 8);
+  outb (reg_lbah (c), (sec_no >> 16));
+  outb (reg_device (c),
+        DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
 }
+/* == My Implementation */
 
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
@@ -3,6 +3,12 @@
 
 #include <inttypes.h>
 #include <stdint.h>
+/* My Implementation */
+#include <stdbool.h>
+#include <stddef.h>
+#include <list.h>
+#include "threads/synch.h"
+/* == My Implementation */
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -22,5 +28,32 @@ struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+/* My Implementation */
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+                          size_t cnt);
+
+/* Asynchronous disk requests, served by one I/O thread per channel. */
+struct disk_request;
+typedef void disk_done_func (struct disk_request *);
+
+struct disk_request
+  {
+    struct disk *disk;          /* Disk to read or write. */
+    disk_sector_t sector;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+    bool write;                 /* Write if true, read otherwise. */
+    disk_done_func *done;       /* Called by the I/O thread when finished. */
+    void *aux;                  /* For DONE's use. */
+    struct semaphore finished;  /* Up'd when finished if DONE is null. */
+    struct list_elem elem;      /* Element in the channel's queue. */
+  };
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+                        void *buffer, size_t cnt, bool write);
+void disk_submit (struct disk_request *);
+void disk_wait (struct disk_request *);
+/* == My Implementation */
 
 #endif /* devices/disk.h */
@@ -24,6 +24,28 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* My Implementation */
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest, that is, the PIT count of one timer tick. */
+#define PIT_TICK_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most timer ticks a single one-shot PIT count can cover. */
+#define PIT_MAX_TICKS (0xffff / PIT_TICK_COUNT)
+
+/* If false (default), the PIT interrupts TIMER_FREQ times per
+   second all the time.
+   If true, the idle thread programs the PIT for a one-shot
+   interrupt at the next alarm deadline.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Number of timer ticks the armed one-shot interrupt stands for,
+   0 if the PIT is in periodic mode, and the PIT count it was
+   programmed with. */
+static int64_t oneshot_ticks;
+static uint16_t oneshot_count;
+/* == My Implementation */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -33,6 +55,11 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+/* My Implementation */
+static void pit_periodic (void);
+static void pit_oneshot (uint16_t count);
+static uint16_t pit_read_count (void);
+/* == My Implementation */
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -40,13 +67,15 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
+  /* Old Implementation
   uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x43, 0x34);
   outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  outb (0x40, count >> 8); */
+  /* My Implementation */
+  pit_periodic ();
+  /* == My Implementation */
 
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -185,29 +214,142 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* My Implementation */
+/* Called by the idle thread, with interrupts off, right before it
+   halts the CPU.  In tickless mode, replaces the periodic timer
+   interrupts with a single one-shot interrupt at the next alarm
+   deadline.  With the MLFQS scheduler, never sleeps past the next
+   one-second boundary so load_avg is still updated on time. */
+void
+timer_idle_enter (void)
+{
+  int64_t n, boundary;
+  uint16_t remain;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || oneshot_ticks != 0)
+    return;
+
+  n = alarm_next_ticks () - ticks;
+  if (n > PIT_MAX_TICKS)
+    n = PIT_MAX_TICKS;
+  boundary = TIMER_FREQ - ticks % TIMER_FREQ;
+  if (thread_mlfqs && n > boundary)
+    n = boundary;
+  if (n <= 1)
+    return;
+
+  /* Keep the phase of the current tick: the first of the N ticks
+     ends when the running period does. */
+  remain = pit_read_count ();
+  if (remain == 0 || remain > PIT_TICK_COUNT)
+    return;
+
+  oneshot_ticks = n;
+  oneshot_count = remain + (n - 1) * PIT_TICK_COUNT;
+  pit_oneshot (oneshot_count);
+}
+
+/* Called by the idle thread, with interrupts off, after an
+   interrupt woke it up.  If the one-shot timer interrupt has not
+   fired yet, catches up the ticks that already elapsed and goes
+   back to periodic mode, since some thread may be ready to run. */
+void
+timer_idle_exit (void)
+{
+  uint16_t remain;
+  int64_t elapsed, n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (oneshot_ticks == 0)
+    return;
+
+  remain = pit_read_count ();
+  if (remain > oneshot_count)   /* Wrapped around past zero. */
+    remain = 0;
+  elapsed = oneshot_count - remain;
+  n = oneshot_count - (oneshot_ticks - 1) * PIT_TICK_COUNT;
+  n = elapsed < n ? 0 : 1 + (elapsed - n) / PIT_TICK_COUNT;
+  if (n >= oneshot_ticks)       /* Let the pending interrupt count the last. */
+    n = oneshot_ticks - 1;
+
+  oneshot_ticks = 0;
+  pit_periodic ();
+
+  ticks += n;
+  thread_tick_idle (n);
+  alarm_check (ticks);
+}
+/* == My Implementation */
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  /* My Implementation */
+  if (oneshot_ticks != 0)
+    {
+      /* Catch up the ticks skipped by the one-shot interrupt,
+         all of them spent idle, and resume periodic ticks. */
+      ticks += oneshot_ticks - 1;
+      thread_tick_idle (oneshot_ticks - 1);
+      oneshot_ticks = 0;
+      pit_periodic ();
+    }
+  /* == My Implementation */
   ticks++;
   thread_tick ();
   
   /* My Implementation */
   if (thread_mlfqs)
   {
-    thread_current ()->recent_cpu = INT_ADD (thread_current ()->recent_cpu, 1);
+    thread_increase_recent_cpu ();
     if (ticks % TIMER_FREQ == 0) /* do this every second */
       {
         thread_calculate_load_avg ();
         thread_calculate_recent_cpu_for_all ();
       }
-    if (ticks % 4 == 3)
-      thread_calculate_priority_for_all ();
+    if (ticks % 4 == 3) /* only the threads whose recent_cpu changed */
+      thread_calculate_priority_for_changed ();
   }
-  alarm_check (); /* Check the alarm and wake up threads */
+  alarm_check (ticks); /* Wake up the threads whose alarms are due */
   /* == My Implementation */
 }
 
+/* My Implementation */
+/* Sets up the PIT to interrupt TIMER_FREQ times per second. */
+static void
+pit_periodic (void)
+{
+  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x40, PIT_TICK_COUNT & 0xff);
+  outb (0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Sets up the PIT to interrupt once, COUNT input cycles from now. */
+static void
+pit_oneshot (uint16_t count)
+{
+  outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read_count (void)
+{
+  uint8_t lo, hi;
+
+  outb (0x43, 0x00);    /* CW: latch counter 0. */
+  lo = inb (0x40);
+  hi = inb (0x40);
+  return lo | (hi << 8);
+}
+/* == My Implementation */
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -7,6 +7,17 @@
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* My Implementation */
+#include <stdbool.h>
+
+/* Tickless idle, controlled by kernel command-line option
+   "-tickless". */
+extern bool timer_tickless;
+
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+/* == My Implementation */
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -0,0 +1,465 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "filesys/cache.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* How often the write-behind thread writes dirty sectors back */
+#define WRITE_BEHIND_TICKS TIMER_FREQ
+
+/* Maximum number of pending read-ahead requests */
+#define READAHEAD_SIZE 16
+
+/* Sectors fetched by one read-ahead request with one disk command,
+ * the blocks of a file tend to be contiguous
+ */
+#define READAHEAD_RUN (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Number of dirty sectors cache_flush() has in flight at once,
+ * the disk orders and merges them
+ */
+#define FLUSH_BATCH 8
+
+/* a cached sector */
+struct cache_entry
+  {
+    disk_sector_t sector;       /* the sector it holds */
+    bool valid;                 /* whether it holds a sector at all */
+    bool dirty;                 /* whether it has to be written back */
+    bool accessed;              /* recently used, for the clock algorithm */
+    int pin_cnt;                /* # of users, not evictable while > 0 */
+
+    struct lock lock;           /* held while accessing data */
+    uint8_t *data;              /* DISK_SECTOR_SIZE bytes of sector data */
+  };
+
+/* The cache entries, cache_lock protects everything but the data,
+ * which is protected by the lock of each entry
+ * Lock order: an entry's lock, then cache_lock
+ */
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static size_t clock_hand;
+static bool cache_ready;        /* whether cache_init() was called */
+
+/* Ring of sectors to read ahead */
+static disk_sector_t readahead_queue[READAHEAD_SIZE];
+static size_t readahead_head;
+static size_t readahead_cnt;
+static struct lock readahead_lock;
+static struct semaphore readahead_sema;
+static uint8_t *readahead_buf;  /* READAHEAD_RUN sectors */
+
+static struct cache_entry *cache_get (disk_sector_t, bool read);
+static void cache_put (struct cache_entry *, bool dirty);
+static struct cache_entry *cache_lookup (disk_sector_t);
+static struct cache_entry *cache_evict (void);
+static struct cache_entry *cache_claim (disk_sector_t);
+static void cache_write_back (struct cache_entry *);
+
+static thread_func write_behind_thread NO_RETURN;
+static thread_func readahead_thread NO_RETURN;
+
+/* Init the buffer cache and start the write-behind
+ * and read-ahead threads
+ */
+void
+cache_init (void)
+{
+  uint8_t *pages;
+  size_t i;
+
+  pages = palloc_get_multiple (PAL_ASSERT,
+                               CACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+
+  lock_init (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].valid = false;
+      cache[i].dirty = false;
+      cache[i].accessed = false;
+      cache[i].pin_cnt = 0;
+      lock_init (&cache[i].lock);
+      cache[i].data = pages + i * DISK_SECTOR_SIZE;
+    }
+  clock_hand = 0;
+  cache_ready = true;
+
+  readahead_head = readahead_cnt = 0;
+  lock_init (&readahead_lock);
+  sema_init (&readahead_sema, 0);
+  readahead_buf = palloc_get_page (PAL_ASSERT);
+
+  thread_create ("cache-flush", PRI_DEFAULT, write_behind_thread, NULL);
+  thread_create ("cache-readahead", PRI_DEFAULT, readahead_thread, NULL);
+}
+
+/* Write everything back, called at shutdown,
+ * which may happen before the file system is initialized
+ */
+void
+cache_done (void)
+{
+  if (cache_ready)
+    cache_flush ();
+}
+
+/* Read the whole SECTOR into BUFFER */
+void
+cache_read (disk_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Write the whole SECTOR from BUFFER */
+void
+cache_write (disk_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Read SIZE bytes at offset OFS of SECTOR into BUFFER */
+void
+cache_read_at (disk_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e, false);
+}
+
+/* Write SIZE bytes from BUFFER at offset OFS of SECTOR,
+ * the sector is only read from disk if it is written partially
+ */
+void
+cache_write_at (disk_sector_t sector, const void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, ofs != 0 || size != DISK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  cache_put (e, true);
+}
+
+/* Ask the read-ahead thread to bring SECTOR and the ones following
+ * it into the cache, the request is dropped if there are too many
+ * pending ones
+ */
+void
+cache_readahead (disk_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_SIZE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt) % READAHEAD_SIZE] = sector;
+      readahead_cnt++;
+      sema_up (&readahead_sema);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Write all the dirty sectors back to disk, FLUSH_BATCH of them are
+ * submitted before waiting for any, so that adjacent ones go out in
+ * one command
+ * Holding several entry locks is safe, others hold at most one and
+ * cache_claim() never waits for one
+ */
+void
+cache_flush (void)
+{
+  struct cache_entry *batch[FLUSH_BATCH];
+  struct disk_request req[FLUSH_BATCH];
+  struct cache_entry *e;
+  size_t cnt, i, j;
+
+  for (i = 0; i < CACHE_SIZE; )
+    {
+      for (cnt = 0; cnt < FLUSH_BATCH && i < CACHE_SIZE; i++)
+        {
+          e = &cache[i];
+
+          lock_acquire (&cache_lock);
+          if (!e->valid || !e->dirty)
+            {
+              lock_release (&cache_lock);
+              continue;
+            }
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+
+          /* The entry is pinned, so it still holds the same sector */
+          lock_acquire (&e->lock);
+          if (!e->dirty)
+            {
+              lock_release (&e->lock);
+              lock_acquire (&cache_lock);
+              e->pin_cnt--;
+              lock_release (&cache_lock);
+              continue;
+            }
+          /* Old Implementation
+          disk_write (filesys_disk, e->sector, e->data);
+          e->dirty = false; */
+          e->dirty = false;
+          disk_request_init (&req[cnt], filesys_disk, e->sector, e->data,
+                             1, true);
+          disk_submit (&req[cnt]);
+          batch[cnt++] = e;
+        }
+
+      for (j = 0; j < cnt; j++)
+        {
+          disk_wait (&req[j]);
+          lock_acquire (&cache_lock);
+          lock_release (&batch[j]->lock);
+          batch[j]->pin_cnt--;
+          lock_release (&cache_lock);
+        }
+    }
+}
+
+/* Returns the pinned and locked entry of SECTOR,
+ * loads it from disk if it is not cached and READ is true
+ * The caller must give it back with cache_put()
+ */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool read)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = cache_lookup (sector);
+      if (e != NULL) /* Cache hit */
+        {
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          lock_acquire (&e->lock);
+          return e;
+        }
+
+      e = cache_evict ();
+      if (e != NULL && e->valid)
+        {
+          /* Dirty, write it back and look again */
+          cache_write_back (e);
+          continue;
+        }
+      if (e != NULL)
+        break;
+
+      /* Every entry is in use, wait for some to be put back */
+      lock_release (&cache_lock);
+      thread_yield ();
+      lock_acquire (&cache_lock);
+    }
+
+  /* Cache miss, nobody holds the lock of an unpinned entry */
+  e->sector = sector;
+  e->valid = true;
+  e->dirty = false;
+  e->accessed = false;
+  e->pin_cnt = 1;
+  lock_acquire (&e->lock);
+  lock_release (&cache_lock);
+
+  if (read)
+    disk_read (filesys_disk, sector, e->data);
+  return e;
+}
+
+/* Returns a pinned and locked entry for SECTOR to be filled by the
+ * caller, or a null pointer if SECTOR is cached already or every
+ * entry is in use
+ */
+static struct cache_entry *
+cache_claim (disk_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      if (cache_lookup (sector) != NULL || (e = cache_evict ()) == NULL)
+        {
+          lock_release (&cache_lock);
+          return NULL;
+        }
+      if (!e->valid)
+        break;
+      cache_write_back (e);
+    }
+  e->sector = sector;
+  e->valid = true;
+  e->dirty = false;
+  e->accessed = false;
+  e->pin_cnt = 1;
+  lock_acquire (&e->lock);
+  lock_release (&cache_lock);
+  return e;
+}
+
+/* Unlock and unpin E, mark it dirty if DIRTY */
+static void
+cache_put (struct cache_entry *e, bool dirty)
+{
+  lock_acquire (&cache_lock);
+  if (dirty)
+    e->dirty = true;
+  e->accessed = true;
+  lock_release (&e->lock);
+  e->pin_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Find the entry of SECTOR, cache_lock must be held */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Choose an entry to hold a new sector with the clock algorithm
+ * A clean one is returned invalidated, ready for reuse, a dirty
+ * one is returned still valid, for the caller to write it back with
+ * cache_write_back() and choose again
+ * Returns a null pointer if every entry is pinned
+ * cache_lock must be held
+ */
+static struct cache_entry *
+cache_evict (void)
+{
+  struct cache_entry *e;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two rounds, the first one may only clear the accessed bits */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->valid)
+        return e;
+      if (e->pin_cnt > 0)
+        continue;
+      if (e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+
+      /* Old Implementation
+      if (e->dirty)
+        {
+          disk_write (filesys_disk, e->sector, e->data);
+          e->dirty = false;
+        } */
+      if (e->dirty)
+        return e;
+      e->valid = false;
+      return e;
+    }
+  return NULL;
+}
+
+/* Write the dirty entry E, chosen by cache_evict(), back to disk
+ * without holding cache_lock, which must be held on entry and is
+ * again on return
+ * E stays valid, pinned and locked meanwhile, so whoever looks its
+ * sector up waits for the write on its lock instead of reading the
+ * stale sector from disk
+ */
+static void
+cache_write_back (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (e->valid && e->dirty && e->pin_cnt == 0);
+
+  /* Nobody holds the lock of an unpinned entry */
+  e->pin_cnt++;
+  lock_acquire (&e->lock);
+  lock_release (&cache_lock);
+
+  disk_write (filesys_disk, e->sector, e->data);
+  e->dirty = false;
+
+  lock_acquire (&cache_lock);
+  lock_release (&e->lock);
+  e->pin_cnt--;
+}
+
+/* Write the dirty sectors back periodically */
+static void
+write_behind_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (WRITE_BEHIND_TICKS);
+      cache_flush ();
+    }
+}
+
+/* Serve the read-ahead requests, each one reads the sectors from the
+ * requested one up to the first cached one in a single disk command
+ * The entries are claimed before reading, so anyone looking one up
+ * meanwhile waits for its data
+ */
+static void
+readahead_thread (void *aux UNUSED)
+{
+  struct cache_entry *run[READAHEAD_RUN];
+  disk_sector_t sector, disk_sectors;
+  size_t cnt, i;
+
+  for (;;)
+    {
+      sema_down (&readahead_sema);
+
+      lock_acquire (&readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      disk_sectors = disk_size (filesys_disk);
+      for (cnt = 0; cnt < READAHEAD_RUN && sector + cnt < disk_sectors; cnt++)
+        {
+          run[cnt] = cache_claim (sector + cnt);
+          if (run[cnt] == NULL)
+            break;
+        }
+      if (cnt == 0)
+        continue;
+
+      disk_read_multiple (filesys_disk, sector, readahead_buf, cnt);
+      for (i = 0; i < cnt; i++)
+        {
+          memcpy (run[i]->data, readahead_buf + i * DISK_SECTOR_SIZE,
+                  DISK_SECTOR_SIZE);
+          cache_put (run[i], false);
+        }
+    }
+}
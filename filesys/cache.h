@@ -0,0 +1,25 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include "devices/disk.h"
+
+/* Number of sectors kept in the buffer cache */
+#define CACHE_SIZE 64
+
+void cache_init (void); /* init the buffer cache and its helper threads */
+void cache_done (void); /* write back everything, at shutdown */
+
+void cache_read (disk_sector_t, void *); /* read a whole sector */
+void cache_write (disk_sector_t, const void *); /* write a whole sector */
+void cache_read_at (disk_sector_t, void *, int ofs, int size); /* read part of a sector */
+void cache_write_at (disk_sector_t, const void *, int ofs, int size); /* write part of a sector */
+
+void cache_readahead (disk_sector_t); /* fetch a sector in the background */
+void cache_flush (void); /* write back all the dirty sectors */
+
+#endif /* filesys/cache.h */
@@ -5,12 +5,20 @@
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+/* My Implementation */
+#include <hash.h>
+#include "threads/slab.h"
+#include "threads/synch.h"
+/* == My Implementation */
 
 /* A directory. */
 struct dir 
   {
     struct inode *inode;                /* Backing store. */
     off_t pos;                          /* Current position. */
+    /* My Implementation */
+    struct dir_index *index;            /* Shared name index and lock. */
+    /* == My Implementation */
   };
 
 /* A single directory entry. */
@@ -21,11 +29,88 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* My Implementation */
+/* In-memory index of the entries of a directory, shared by all
+ * the open struct dir of the same inode
+ * It is loaded from disk on the first lookup and kept in sync
+ * by dir_add() and dir_remove() afterwards
+ * It outlives the last struct dir using it, so that opening the
+ * directory again does not reload it, until it is evicted or the
+ * directory is removed
+ * Its lock serializes the operations on the directory
+ */
+struct dir_index
+  {
+    disk_sector_t sector;               /* inode sector of the directory */
+    int open_cnt;                       /* # of struct dir using it */
+    struct lock lock;                   /* protects the directory and below */
+    bool loaded;                        /* whether the fields below are valid */
+    struct hash names;                  /* used slots, by name */
+    struct list free_slots;             /* unused slots, by offset */
+    struct hash_elem elem;              /* in dir_indexes */
+    struct list_elem unused_elem;       /* in unused_indexes, if not open */
+  };
+
+/* Number of indexes kept when no struct dir uses them */
+#define UNUSED_INDEX_MAX 8
+
+/* A slot of a directory, in use or not */
+struct dir_slot
+  {
+    off_t ofs;                          /* byte offset of the dir_entry */
+    disk_sector_t inode_sector;         /* sector of the inode, if in use */
+    char name[NAME_MAX + 1];            /* file name, if in use */
+    struct hash_elem hash_elem;         /* in names, if in use */
+    struct list_elem list_elem;         /* in free_slots, if not */
+  };
+
+/* Indexes of the directories, by sector, and the ones not open,
+ * least recently used first
+ */
+static struct hash dir_indexes;
+static struct list unused_indexes;
+static size_t unused_index_cnt;
+static struct lock dir_indexes_lock;    /* protects the above and open_cnt */
+
+static struct kmem_cache *dir_cache;    /* struct dir */
+static struct kmem_cache *dir_slot_cache; /* struct dir_slot */
+
+static struct dir_index *dir_index_open (disk_sector_t);
+static void dir_index_close (struct dir_index *);
+static void dir_index_drop (disk_sector_t);
+static bool dir_index_evict (void);
+static bool dir_index_reclaim (void);
+static void dir_index_free (struct dir_index *);
+static bool dir_index_load (struct dir_index *, struct inode *);
+static struct dir_slot *dir_index_find (struct dir_index *, const char *name);
+static list_less_func dir_slot_less;
+static hash_hash_func dir_index_hash;
+static hash_less_func dir_index_less;
+
+/* Initializes the directory module */
+void
+dir_init (void)
+{
+  if (!hash_init (&dir_indexes, dir_index_hash, dir_index_less, NULL))
+    PANIC ("directory index table creation failed");
+  list_init (&unused_indexes);
+  unused_index_cnt = 0;
+  lock_init (&dir_indexes_lock);
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
+  dir_slot_cache = kmem_cache_create ("dir_slot", sizeof (struct dir_slot),
+                                      NULL);
+}
+/* == My Implementation */
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) 
 {
+  /* My Implementation */
+  /* An index left by a removed directory in SECTOR is stale. */
+  dir_index_drop (sector);
+  /* == My Implementation */
   return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
 }
 
@@ -34,17 +119,34 @@ dir_create (disk_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  /* Old Implementation
+  struct dir *dir = calloc (1, sizeof *dir); */
+  /* My Implementation */
+  struct dir *dir = kmem_cache_alloc (dir_cache);
+  /* == My Implementation */
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
       dir->pos = 0;
+      /* My Implementation */
+      dir->index = dir_index_open (inode_get_inumber (inode));
+      if (dir->index == NULL)
+        {
+          inode_close (inode);
+          kmem_cache_free (dir_cache, dir);
+          return NULL;
+        }
+      /* == My Implementation */
       return dir;
     }
   else
     {
       inode_close (inode);
-      free (dir);
+      /* Old Implementation
+      free (dir); */
+      /* My Implementation */
+      kmem_cache_free (dir_cache, dir);
+      /* == My Implementation */
       return NULL; 
     }
 }
@@ -71,8 +173,15 @@ dir_close (struct dir *dir)
 {
   if (dir != NULL)
     {
+      /* My Implementation */
+      dir_index_close (dir->index);
+      /* == My Implementation */
       inode_close (dir->inode);
-      free (dir);
+      /* Old Implementation
+      free (dir); */
+      /* My Implementation */
+      kmem_cache_free (dir_cache, dir);
+      /* == My Implementation */
     }
 }
 
@@ -98,6 +207,27 @@ lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* My Implementation */
+  ASSERT (lock_held_by_current_thread (&dir->index->lock));
+
+  /* If the index cannot be loaded, just scan the entries on disk. */
+  if (dir->index->loaded || dir_index_load (dir->index, dir->inode))
+    {
+      struct dir_slot *slot = dir_index_find (dir->index, name);
+      if (slot == NULL)
+        return false;
+      if (ep != NULL)
+        {
+          ep->inode_sector = slot->inode_sector;
+          strlcpy (ep->name, slot->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = slot->ofs;
+      return true;
+    }
+  /* == My Implementation */
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -124,10 +254,16 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* My Implementation */
+  lock_acquire (&dir->index->lock);
+  /* == My Implementation */
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
+  /* My Implementation */
+  lock_release (&dir->index->lock);
+  /* == My Implementation */
 
   return *inode != NULL;
 }
@@ -144,6 +280,9 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   struct dir_entry e;
   off_t ofs;
   bool success = false;
+  /* My Implementation */
+  struct dir_slot *slot = NULL;
+  /* == My Implementation */
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -152,6 +291,10 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  /* My Implementation */
+  lock_acquire (&dir->index->lock);
+  /* == My Implementation */
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -163,10 +306,34 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
+  /* Old Implementation
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (!e.in_use)
-      break;
+      break; */
+  /* My Implementation */
+  /* The lookup above loaded the index if there is one, which
+     knows the free slots. */
+  if (dir->index->loaded)
+    {
+      if (!list_empty (&dir->index->free_slots))
+        slot = list_entry (list_pop_front (&dir->index->free_slots),
+                           struct dir_slot, list_elem);
+      else
+        {
+          slot = kmem_cache_alloc (dir_slot_cache);
+          if (slot == NULL)
+            goto done;
+          slot->ofs = inode_length (dir->inode);
+        }
+      ofs = slot->ofs;
+    }
+  else
+    for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e) 
+      if (!e.in_use)
+        break;
+  /* == My Implementation */
 
   /* Write slot. */
   e.in_use = true;
@@ -174,7 +341,26 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+  /* My Implementation */
+  if (slot != NULL)
+    {
+      if (success)
+        {
+          slot->inode_sector = inode_sector;
+          strlcpy (slot->name, name, sizeof slot->name);
+          hash_insert (&dir->index->names, &slot->hash_elem);
+        }
+      else if (slot->ofs < inode_length (dir->inode))
+        list_push_front (&dir->index->free_slots, &slot->list_elem);
+      else
+        kmem_cache_free (dir_slot_cache, slot);
+    }
+  /* == My Implementation */
+
  done:
+  /* My Implementation */
+  lock_release (&dir->index->lock);
+  /* == My Implementation */
   return success;
 }
 
@@ -192,6 +378,10 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* My Implementation */
+  lock_acquire (&dir->index->lock);
+  /* == My Implementation */
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -206,11 +396,27 @@ dir_remove (struct dir *dir, const char *name)
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  /* My Implementation */
+  if (dir->index->loaded)
+    {
+      struct dir_slot *slot = dir_index_find (dir->index, name);
+      hash_delete (&dir->index->names, &slot->hash_elem);
+      list_insert_ordered (&dir->index->free_slots, &slot->list_elem,
+                           dir_slot_less, NULL);
+    }
+  /* == My Implementation */
+
   /* Remove inode. */
   inode_remove (inode);
+  /* My Implementation */
+  dir_index_drop (e.inode_sector);
+  /* == My Implementation */
   success = true;
 
  done:
+  /* My Implementation */
+  lock_release (&dir->index->lock);
+  /* == My Implementation */
   inode_close (inode);
   return success;
 }
@@ -222,15 +428,271 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  /* My Implementation */
+  bool success = false;
 
+  lock_acquire (&dir->index->lock);
+  /* == My Implementation */
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          /* Old Implementation
+          return true; */
+          /* My Implementation */
+          success = true;
+          break;
+          /* == My Implementation */
         } 
     }
-  return false;
+  /* Old Implementation
+  return false; */
+  /* My Implementation */
+  lock_release (&dir->index->lock);
+  return success;
+  /* == My Implementation */
+}
+
+/* My Implementation */
+static unsigned
+dir_slot_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct dir_slot, hash_elem)->name);
+}
+
+static bool
+dir_slot_name_less (const struct hash_elem *a, const struct hash_elem *b,
+                    void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct dir_slot, hash_elem)->name,
+                 hash_entry (b, struct dir_slot, hash_elem)->name) < 0;
+}
+
+/* Orders free slots by offset, so that dir_add() fills the
+ * first free slot like the scan on disk does
+ */
+static bool
+dir_slot_less (const struct list_elem *a, const struct list_elem *b,
+               void *aux UNUSED)
+{
+  return list_entry (a, struct dir_slot, list_elem)->ofs
+         < list_entry (b, struct dir_slot, list_elem)->ofs;
+}
+
+static void
+dir_slot_free (struct hash_elem *e, void *aux UNUSED)
+{
+  kmem_cache_free (dir_slot_cache,
+                   hash_entry (e, struct dir_slot, hash_elem));
+}
+
+static unsigned
+dir_index_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct dir_index, elem)->sector);
+}
+
+static bool
+dir_index_less (const struct hash_elem *a, const struct hash_elem *b,
+                void *aux UNUSED)
+{
+  return hash_entry (a, struct dir_index, elem)->sector
+         < hash_entry (b, struct dir_index, elem)->sector;
+}
+
+/* Returns the index of the directory in SECTOR, creating an
+ * unloaded one if there is none yet
+ * Returns a null pointer if memory runs out
+ */
+static struct dir_index *
+dir_index_open (disk_sector_t sector)
+{
+  struct dir_index *index, key;
+  struct hash_elem *e;
+
+  lock_acquire (&dir_indexes_lock);
+  key.sector = sector;
+  e = hash_find (&dir_indexes, &key.elem);
+  if (e != NULL)
+    {
+      index = hash_entry (e, struct dir_index, elem);
+      if (index->open_cnt++ == 0)
+        {
+          list_remove (&index->unused_elem);
+          unused_index_cnt--;
+        }
+      lock_release (&dir_indexes_lock);
+      return index;
+    }
+
+  index = malloc (sizeof *index);
+  if (index == NULL && dir_index_evict ())
+    index = malloc (sizeof *index);
+  if (index != NULL)
+    {
+      index->sector = sector;
+      index->open_cnt = 1;
+      lock_init (&index->lock);
+      index->loaded = false;
+      hash_insert (&dir_indexes, &index->elem);
+    }
+  lock_release (&dir_indexes_lock);
+  return index;
+}
+
+/* Drops a reference to INDEX, keeping it among the unused ones
+ * after the last one, and evicts the least recently used unused
+ * index if there are too many
+ */
+static void
+dir_index_close (struct dir_index *index)
+{
+  lock_acquire (&dir_indexes_lock);
+  if (--index->open_cnt == 0)
+    {
+      list_push_back (&unused_indexes, &index->unused_elem);
+      if (++unused_index_cnt > UNUSED_INDEX_MAX)
+        dir_index_evict ();
+    }
+  lock_release (&dir_indexes_lock);
+}
+
+/* Frees the index of the directory in SECTOR, if there is one and
+ * no struct dir uses it
+ */
+static void
+dir_index_drop (disk_sector_t sector)
+{
+  struct dir_index *index = NULL, key;
+  struct hash_elem *e;
+
+  lock_acquire (&dir_indexes_lock);
+  key.sector = sector;
+  e = hash_find (&dir_indexes, &key.elem);
+  if (e != NULL && hash_entry (e, struct dir_index, elem)->open_cnt == 0)
+    {
+      index = hash_entry (e, struct dir_index, elem);
+      hash_delete (&dir_indexes, &index->elem);
+      list_remove (&index->unused_elem);
+      unused_index_cnt--;
+    }
+  lock_release (&dir_indexes_lock);
+  if (index != NULL)
+    dir_index_free (index);
+}
+
+/* Frees the least recently used unused index
+ * Returns false if there is none
+ * dir_indexes_lock must be held
+ */
+static bool
+dir_index_evict (void)
+{
+  struct dir_index *index;
+
+  ASSERT (lock_held_by_current_thread (&dir_indexes_lock));
+
+  if (list_empty (&unused_indexes))
+    return false;
+  index = list_entry (list_pop_front (&unused_indexes),
+                      struct dir_index, unused_elem);
+  unused_index_cnt--;
+  hash_delete (&dir_indexes, &index->elem);
+  dir_index_free (index);
+  return true;
+}
+
+/* Frees the least recently used unused index when memory runs
+ * out, returns false if there is none
+ */
+static bool
+dir_index_reclaim (void)
+{
+  bool success;
+
+  lock_acquire (&dir_indexes_lock);
+  success = dir_index_evict ();
+  lock_release (&dir_indexes_lock);
+  return success;
+}
+
+/* Frees INDEX and its slots, nobody may be using it */
+static void
+dir_index_free (struct dir_index *index)
+{
+  if (index->loaded)
+    {
+      while (!list_empty (&index->free_slots))
+        kmem_cache_free (dir_slot_cache,
+                         list_entry (list_pop_front (&index->free_slots),
+                                     struct dir_slot, list_elem));
+      hash_destroy (&index->names, dir_slot_free);
+    }
+  free (index);
+}
+
+/* Reads all the entries of the directory INODE into INDEX
+ * Returns false, leaving INDEX unloaded, if memory runs out
+ */
+static bool
+dir_index_load (struct dir_index *index, struct inode *inode)
+{
+  struct dir_entry e;
+  struct dir_slot *slot;
+  off_t ofs;
+
+  ASSERT (!index->loaded);
+
+  if (!hash_init (&index->names, dir_slot_hash, dir_slot_name_less, NULL))
+    return false;
+  list_init (&index->free_slots);
+
+  for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    {
+      slot = kmem_cache_alloc (dir_slot_cache);
+      if (slot == NULL && dir_index_reclaim ())
+        slot = kmem_cache_alloc (dir_slot_cache);
+      if (slot == NULL)
+        {
+          while (!list_empty (&index->free_slots))
+            kmem_cache_free (dir_slot_cache,
+                             list_entry (list_pop_front (&index->free_slots),
+                                         struct dir_slot, list_elem));
+          hash_destroy (&index->names, dir_slot_free);
+          return false;
+        }
+      slot->ofs = ofs;
+      if (e.in_use)
+        {
+          slot->inode_sector = e.inode_sector;
+          strlcpy (slot->name, e.name, sizeof slot->name);
+          hash_insert (&index->names, &slot->hash_elem);
+        }
+      else
+        list_push_back (&index->free_slots, &slot->list_elem);
+    }
+
+  index->loaded = true;
+  return true;
+}
+
+/* Returns the slot of NAME in the loaded INDEX, or a null pointer */
+static struct dir_slot *
+dir_index_find (struct dir_index *index, const char *name)
+{
+  struct dir_slot key;
+  struct hash_elem *e;
+
+  ASSERT (index->loaded);
+
+  /* A longer name would be truncated into a wrong key */
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&index->names, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dir_slot, hash_elem) : NULL;
 }
+/* == My Implementation */
@@ -13,6 +13,10 @@
 
 struct inode;
 
+/* My Implementation */
+void dir_init (void);
+/* == My Implementation */
+
 /* Opening and closing directories. */
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
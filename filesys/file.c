@@ -2,6 +2,9 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+/* My Implementation */
+#include "threads/slab.h"
+/* == My Implementation */
 
 /* An open file. */
 struct file 
@@ -11,13 +14,28 @@ struct file
     bool deny_write;            /* Has file_deny_write() been called? */
   };
 
+/* My Implementation */
+static struct kmem_cache *file_cache;   /* struct file */
+
+/* Initializes the file module */
+void
+file_init (void)
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+}
+/* == My Implementation */
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  /* Old Implementation
+  struct file *file = calloc (1, sizeof *file); */
+  /* My Implementation */
+  struct file *file = kmem_cache_alloc (file_cache);
+  /* == My Implementation */
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
@@ -28,7 +46,11 @@ file_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (file);
+      /* Old Implementation
+      free (file); */
+      /* My Implementation */
+      kmem_cache_free (file_cache, file);
+      /* == My Implementation */
       return NULL; 
     }
 }
@@ -49,7 +71,11 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      /* Old Implementation
+      free (file); */
+      /* My Implementation */
+      kmem_cache_free (file_cache, file);
+      /* == My Implementation */
     }
 }
 
@@ -87,9 +113,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +127,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -5,6 +5,10 @@
 
 struct inode;
 
+/* My Implementation */
+void file_init (void);
+/* == My Implementation */
+
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
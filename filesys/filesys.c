@@ -7,6 +7,9 @@
 #include "filesys/inode.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
+/* My Implementation */
+#include "filesys/cache.h"
+/* == My Implementation */
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
@@ -22,7 +25,14 @@ filesys_init (bool format)
   if (filesys_disk == NULL)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+  /* My Implementation */
+  cache_init ();
+  /* == My Implementation */
   inode_init ();
+  /* My Implementation */
+  dir_init ();
+  file_init ();
+  /* == My Implementation */
   free_map_init ();
 
   if (format) 
@@ -37,6 +47,9 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  /* My Implementation */
+  cache_done ();
+  /* == My Implementation */
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -49,7 +62,11 @@ filesys_create (const char *name, off_t initial_size)
   disk_sector_t inode_sector = 0;
   struct dir *dir = dir_open_root ();
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  /* Old Implementation
+                  && free_map_allocate (1, &inode_sector) */
+                  /* My Implementation */
+                  && free_map_allocate_near (1, ROOT_DIR_SECTOR, &inode_sector)
+                  /* == My Implementation */
                   && inode_create (inode_sector, initial_size)
                   && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
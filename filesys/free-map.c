@@ -4,10 +4,49 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+/* My Implementation */
+#include <hash.h>
+#include <list.h>
+#include "threads/slab.h"
+#include "threads/synch.h"
+/* == My Implementation */
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* My Implementation */
+/* A run of free sectors, kept in memory alongside the bitmap */
+struct extent
+  {
+    disk_sector_t start;             /* first free sector */
+    size_t size;                     /* # of free sectors */
+    struct hash_elem start_elem;     /* in extents_by_start */
+    struct hash_elem end_elem;       /* in extents_by_end, keyed by start + size */
+    struct list_elem size_elem;      /* in the size class of size, ordered */
+  };
+
+/* Number of size classes, class K holds the extents with
+ * 2^K <= size < 2^(K+1), smallest first
+ */
+#define EXTENT_CLASS_CNT 32
+
+static struct hash extents_by_start; /* free extents by first sector */
+static struct hash extents_by_end;   /* free extents by sector after the last */
+static struct list extent_classes[EXTENT_CLASS_CNT];
+static struct kmem_cache *extent_cache; /* struct extent */
+
+/* Protects the bitmap and the extent index
+ * Lock order: an inode being written, free_map_lock, then the
+ * free map inode
+ */
+static struct lock free_map_lock;
+
+static void extent_index_build (void);
+static bool extent_take (size_t cnt, bool use_hint, disk_sector_t hint,
+                         disk_sector_t *sectorp);
+static void extent_give (disk_sector_t sector, size_t cnt);
+/* == My Implementation */
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -17,6 +56,11 @@ free_map_init (void)
     PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  /* My Implementation */
+  lock_init (&free_map_lock);
+  extent_cache = kmem_cache_create ("extent", sizeof (struct extent), NULL);
+  extent_index_build ();
+  /* == My Implementation */
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -26,6 +70,7 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
+  /* Old Implementation
   disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
       && free_map_file != NULL
@@ -36,16 +81,50 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp)
     }
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  return sector != BITMAP_ERROR; */
+  /* My Implementation */
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = extent_take (cnt, false, 0, sectorp);
+  lock_release (&free_map_lock);
+  return success;
+  /* == My Implementation */
+}
+
+/* My Implementation */
+/* Like free_map_allocate(), but prefers the sectors right after
+   HINT, so that the blocks of a file follow each other and its
+   inode on disk.  Falls back to the best fit. */
+bool
+free_map_allocate_near (size_t cnt, disk_sector_t hint,
+                        disk_sector_t *sectorp)
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = extent_take (cnt, true, hint, sectorp);
+  lock_release (&free_map_lock);
+  return success;
 }
+/* == My Implementation */
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  /* My Implementation */
+  lock_acquire (&free_map_lock);
+  /* == My Implementation */
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
+  /* My Implementation */
+  extent_give (sector, cnt);
+  /* == My Implementation */
   bitmap_write (free_map, free_map_file);
+  /* My Implementation */
+  lock_release (&free_map_lock);
+  /* == My Implementation */
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -57,6 +136,9 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  /* My Implementation */
+  extent_index_build ();
+  /* == My Implementation */
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -72,7 +154,12 @@ void
 free_map_create (void) 
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  /* Old Implementation
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map))) */
+  /* My Implementation */
+  /* Writing the free map must not allocate from it. */
+  if (!inode_create_allocated (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  /* == My Implementation */
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
@@ -82,3 +169,255 @@ free_map_create (void)
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
+
+/* My Implementation */
+static unsigned
+extent_start_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct extent, start_elem)->start);
+}
+
+static bool
+extent_start_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return hash_entry (a, struct extent, start_elem)->start
+         < hash_entry (b, struct extent, start_elem)->start;
+}
+
+static unsigned
+extent_end_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct extent *x = hash_entry (e, struct extent, end_elem);
+  return hash_int (x->start + x->size);
+}
+
+static bool
+extent_end_less (const struct hash_elem *a, const struct hash_elem *b,
+                 void *aux UNUSED)
+{
+  const struct extent *x = hash_entry (a, struct extent, end_elem);
+  const struct extent *y = hash_entry (b, struct extent, end_elem);
+  return x->start + x->size < y->start + y->size;
+}
+
+static void
+extent_free (struct hash_elem *e, void *aux UNUSED)
+{
+  kmem_cache_free (extent_cache, hash_entry (e, struct extent, start_elem));
+}
+
+/* Returns the size class of an extent of SIZE sectors */
+static int
+extent_class (size_t size)
+{
+  ASSERT (size > 0);
+  return 31 - __builtin_clz (size);
+}
+
+/* Puts X in its size class, after the extents no larger
+ * The walk starts from the back, the largest, so that the many
+ * extents of equal size in the small classes are not walked over
+ */
+static void
+extent_class_insert (struct extent *x)
+{
+  struct list *class = &extent_classes[extent_class (x->size)];
+  struct list_elem *e;
+
+  for (e = list_rbegin (class); e != list_rend (class); e = list_prev (e))
+    if (list_entry (e, struct extent, size_elem)->size <= x->size)
+      break;
+  list_insert (list_next (e), &x->size_elem);
+}
+
+/* Adds a free extent of SIZE sectors at START to the index */
+static void
+extent_insert (disk_sector_t start, size_t size)
+{
+  struct extent *x = kmem_cache_alloc (extent_cache);
+  if (x == NULL)
+    PANIC ("free map extent allocation failed");
+  x->start = start;
+  x->size = size;
+  hash_insert (&extents_by_start, &x->start_elem);
+  hash_insert (&extents_by_end, &x->end_elem);
+  extent_class_insert (x);
+}
+
+/* Removes X from the index, without freeing it */
+static void
+extent_remove (struct extent *x)
+{
+  hash_delete (&extents_by_start, &x->start_elem);
+  hash_delete (&extents_by_end, &x->end_elem);
+  list_remove (&x->size_elem);
+}
+
+/* Returns the free extent starting at START, or a null pointer */
+static struct extent *
+extent_find_start (disk_sector_t start)
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = start;
+  e = hash_find (&extents_by_start, &key.start_elem);
+  return e != NULL ? hash_entry (e, struct extent, start_elem) : NULL;
+}
+
+/* Returns the free extent ending right before END, or a null pointer */
+static struct extent *
+extent_find_end (disk_sector_t end)
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = end;
+  key.size = 0;
+  e = hash_find (&extents_by_end, &key.end_elem);
+  return e != NULL ? hash_entry (e, struct extent, end_elem) : NULL;
+}
+
+/* Returns the smallest free extent of at least CNT sectors,
+ * or a null pointer if there is none
+ * The classes are ordered by size, so the first fit in the class
+ * of CNT is the best one, and if it has none, the head of the next
+ * non-empty class is
+ */
+static struct extent *
+extent_best_fit (size_t cnt)
+{
+  struct list_elem *e;
+  struct list *class;
+  int k;
+
+  class = &extent_classes[extent_class (cnt)];
+  for (e = list_begin (class); e != list_end (class); e = list_next (e))
+    {
+      struct extent *x = list_entry (e, struct extent, size_elem);
+      if (x->size >= cnt)
+        return x;
+    }
+
+  for (k = extent_class (cnt) + 1; k < EXTENT_CLASS_CNT; k++)
+    if (!list_empty (&extent_classes[k]))
+      return list_entry (list_front (&extent_classes[k]),
+                         struct extent, size_elem);
+  return NULL;
+}
+
+/* Rebuilds the free extent index from the bitmap */
+static void
+extent_index_build (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t start, end;
+  int k;
+
+  if (extents_by_start.buckets == NULL)
+    {
+      if (!hash_init (&extents_by_start, extent_start_hash,
+                      extent_start_less, NULL)
+          || !hash_init (&extents_by_end, extent_end_hash,
+                         extent_end_less, NULL))
+        PANIC ("free map extent index creation failed");
+    }
+  else
+    {
+      hash_clear (&extents_by_end, NULL);
+      hash_clear (&extents_by_start, extent_free);
+    }
+  for (k = 0; k < EXTENT_CLASS_CNT; k++)
+    list_init (&extent_classes[k]);
+
+  for (start = 0; start < size; start = end)
+    {
+      start = bitmap_scan (free_map, start, 1, false);
+      if (start == BITMAP_ERROR)
+        break;
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = size;
+      extent_insert (start, end - start);
+    }
+}
+
+/* Allocates CNT consecutive sectors, from the front of the free
+ * extent right after HINT if USE_HINT and it is large enough,
+ * otherwise from the best fitting extent
+ * Marks them in the bitmap and writes it back
+ */
+static bool
+extent_take (size_t cnt, bool use_hint, disk_sector_t hint,
+             disk_sector_t *sectorp)
+{
+  struct extent *x = NULL;
+  disk_sector_t sector;
+
+  if (cnt == 0)
+    return false;
+
+  /* HINT is in use, so a free sector after it starts an extent */
+  if (use_hint)
+    {
+      x = extent_find_start (hint + 1);
+      if (x != NULL && x->size < cnt)
+        x = NULL;
+    }
+  if (x == NULL)
+    x = extent_best_fit (cnt);
+  if (x == NULL)
+    return false;
+
+  sector = x->start;
+  extent_remove (x);
+  if (x->size > cnt)
+    {
+      /* Reuse X for the rest */
+      x->start += cnt;
+      x->size -= cnt;
+      hash_insert (&extents_by_start, &x->start_elem);
+      hash_insert (&extents_by_end, &x->end_elem);
+      extent_class_insert (x);
+    }
+  else
+    kmem_cache_free (extent_cache, x);
+
+  ASSERT (bitmap_none (free_map, sector, cnt));
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  if (free_map_file != NULL && !bitmap_write (free_map, free_map_file))
+    {
+      bitmap_set_multiple (free_map, sector, cnt, false);
+      extent_give (sector, cnt);
+      return false;
+    }
+  *sectorp = sector;
+  return true;
+}
+
+/* Returns CNT sectors at SECTOR to the index, merging them with
+ * the free extents right before and after
+ */
+static void
+extent_give (disk_sector_t sector, size_t cnt)
+{
+  struct extent *before = extent_find_end (sector);
+  struct extent *after = extent_find_start (sector + cnt);
+
+  if (before != NULL)
+    {
+      extent_remove (before);
+      sector = before->start;
+      cnt += before->size;
+      kmem_cache_free (extent_cache, before);
+    }
+  if (after != NULL)
+    {
+      extent_remove (after);
+      cnt += after->size;
+      kmem_cache_free (extent_cache, after);
+    }
+  extent_insert (sector, cnt);
+}
+/* == My Implementation */
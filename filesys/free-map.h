@@ -12,6 +12,9 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, disk_sector_t *);
+/* My Implementation */
+bool free_map_allocate_near (size_t, disk_sector_t hint, disk_sector_t *);
+/* == My Implementation */
 void free_map_release (disk_sector_t, size_t);
 
 #endif /* filesys/free-map.h */
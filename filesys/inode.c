@@ -6,18 +6,49 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+/* My Implementation */
+#include <hash.h>
+#include "filesys/cache.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+/* == My Implementation */
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* My Implementation */
+/* Number of direct, indirect and doubly indirect data sectors
+   an inode can map. */
+#define DIRECT_CNT 124
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+#define DOUBLY_INDIRECT_CNT (INDIRECT_CNT * INDIRECT_CNT)
+
+/* Largest file an inode can map. */
+#define INODE_MAX_LENGTH \
+  ((off_t) ((DIRECT_CNT + INDIRECT_CNT + DOUBLY_INDIRECT_CNT) \
+            * DISK_SECTOR_SIZE))
+
+/* A sector that is not allocated, which reads as all zeros.
+   Sector 0 always holds the free map inode, so it is never a data
+   or index sector. */
+#define SECTOR_NONE 0
+/* == My Implementation */
+
 /* On-disk inode.
    Must be exactly DISK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    disk_sector_t start;                /* First data sector. */
+    /* Old Implementation
+    disk_sector_t start; */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    /* Old Implementation
+    uint32_t unused[125]; */
+    /* My Implementation */
+    disk_sector_t direct[DIRECT_CNT];   /* Direct data sectors. */
+    disk_sector_t indirect;             /* Sector of data sectors. */
+    disk_sector_t doubly_indirect;      /* Sector of indirect sectors. */
+    /* == My Implementation */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,47 +62,135 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    /* Old Implementation
+    struct list_elem elem; */
+    /* My Implementation */
+    struct hash_elem elem;              /* Element in open_inodes. */
+    /* == My Implementation */
     disk_sector_t sector;               /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    /* My Implementation */
+    struct rwlock rwlock;               /* Readers share, writers don't. */
+    /* == My Implementation */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* My Implementation */
+static disk_sector_t index_to_sector (struct inode_disk *, size_t idx,
+                                      bool allocate, disk_sector_t hint);
+static disk_sector_t index_slot (disk_sector_t *slot, bool allocate,
+                                 disk_sector_t *hint);
+static disk_sector_t index_table (disk_sector_t table, size_t idx,
+                                  bool allocate, disk_sector_t *hint);
+static void index_release (disk_sector_t sector, int level);
+static void inode_release (struct inode_disk *);
+static bool do_create (disk_sector_t, off_t, bool allocate);
+/* == My Implementation */
+
 /* Returns the disk sector that contains byte offset POS within
    INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns SECTOR_NONE if INODE does not contain data for a byte
+   at offset POS, either past the end of file or in a hole that
+   was never written. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
+  /* Old Implementation
   if (pos < inode->data.length)
     return inode->data.start + pos / DISK_SECTOR_SIZE;
   else
-    return -1;
+    return -1; */
+  /* My Implementation */
+  if (pos < inode->data.length)
+    return index_to_sector (&inode->data, pos / DISK_SECTOR_SIZE, false, 0);
+  else
+    return SECTOR_NONE;
+  /* == My Implementation */
 }
 
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
-static struct list open_inodes;
+/* Old Implementation
+static struct list open_inodes; */
+/* My Implementation */
+/* Open inodes by sector, so that opening a single inode twice
+   returns the same `struct inode'.  open_inodes_lock protects the
+   table and the open_cnt of every open inode. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+/* In-memory inodes, a free one has its rwlock initialized */
+static struct kmem_cache *inode_cache;
+
+static void
+inode_ctor (void *inode)
+{
+  rwlock_init (&((struct inode *) inode)->rwlock);
+}
+
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return hash_entry (a, struct inode, elem)->sector
+         < hash_entry (b, struct inode, elem)->sector;
+}
+/* == My Implementation */
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  /* Old Implementation
+  list_init (&open_inodes); */
+  /* My Implementation */
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("open inode table creation failed");
+  lock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), inode_ctor);
+  /* == My Implementation */
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
    disk.
+   The data sectors are left unallocated, reading as zeros until
+   they are first written.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
 inode_create (disk_sector_t sector, off_t length)
 {
+  /* My Implementation */
+  return do_create (sector, length, false);
+  /* == My Implementation */
+}
+
+/* My Implementation */
+/* As inode_create(), but allocates every data sector up front.
+   For the free map file, whose writes must not allocate sectors
+   from the free map being written. */
+bool
+inode_create_allocated (disk_sector_t sector, off_t length)
+{
+  return do_create (sector, length, true);
+}
+
+/* Creates the inode as inode_create() does, allocating its data
+   sectors if ALLOCATE. */
+static bool
+do_create (disk_sector_t sector, off_t length, bool allocate)
+{
+/* == My Implementation */
   struct inode_disk *disk_inode = NULL;
   bool success = false;
 
@@ -81,25 +200,46 @@ inode_create (disk_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+  /* My Implementation */
+  if (length > INODE_MAX_LENGTH)
+    return false;
+  /* == My Implementation */
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
+      /* Old Implementation
+      size_t sectors = bytes_to_sectors (length); */
+      /* My Implementation */
+      size_t sectors = allocate ? bytes_to_sectors (length) : 0;
+      size_t i;
+      disk_sector_t prev = sector;
+      /* == My Implementation */
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      /* Old Implementation
+      if (free_map_allocate (sectors, &disk_inode->start)) */
+      /* My Implementation */
+      /* If ALLOCATE, sectors are allocated one by one through the
+         index, so they need not be contiguous, but each one is
+         placed after the previous one (or the inode) if possible;
+         each new sector is zeroed.  Otherwise they are all holes. */
+      for (i = 0; i < sectors; i++)
         {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
-            }
+          prev = index_to_sector (disk_inode, i, true, prev);
+          if (prev == SECTOR_NONE)
+            break;
+        }
+      if (i == sectors)
+      /* == My Implementation */
+        {
+          cache_write (sector, disk_inode);
           success = true; 
         } 
+      /* My Implementation */
+      else
+        inode_release (disk_inode);
+      /* == My Implementation */
       free (disk_inode);
     }
   return success;
@@ -111,10 +251,16 @@ inode_create (disk_sector_t sector, off_t length)
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
+  /* Old Implementation
+  struct list_elem *e; */
   struct inode *inode;
+  /* My Implementation */
+  struct inode key;
+  struct hash_elem *e;
+  /* == My Implementation */
 
   /* Check whether this inode is already open. */
+  /* Old Implementation
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
        e = list_next (e)) 
     {
@@ -124,20 +270,52 @@ inode_open (disk_sector_t sector)
           inode_reopen (inode);
           return inode; 
         }
+    } */
+  /* My Implementation */
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
+    {
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode;
     }
+  lock_release (&open_inodes_lock);
+  /* == My Implementation */
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  /* Old Implementation
+  inode = malloc (sizeof *inode); */
+  /* My Implementation */
+  inode = kmem_cache_alloc (inode_cache);
+  /* == My Implementation */
   if (inode == NULL)
     return NULL;
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Old Implementation
+  list_push_front (&open_inodes, &inode->elem); */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  cache_read (inode->sector, &inode->data);
+
+  /* My Implementation */
+  /* The disk was read without the lock, so somebody else may
+     have opened the same inode meanwhile. */
+  lock_acquire (&open_inodes_lock);
+  e = hash_insert (&open_inodes, &inode->elem);
+  if (e != NULL)
+    {
+      kmem_cache_free (inode_cache, inode);
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+    }
+  lock_release (&open_inodes_lock);
+  /* == My Implementation */
   return inode;
 }
 
@@ -146,7 +324,15 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    /* Old Implementation
+    inode->open_cnt++; */
+    /* My Implementation */
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
+    /* == My Implementation */
   return inode;
 }
 
@@ -168,20 +354,41 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  /* Old Implementation
   if (--inode->open_cnt == 0)
+    { */
+  /* My Implementation */
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
+    {
+      lock_release (&open_inodes_lock);
+      return;
+    }
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+  /* == My Implementation */
     {
       /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      /* Old Implementation
+      list_remove (&inode->elem); */
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
+          /* Old Implementation
           free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+                            bytes_to_sectors (inode->data.length)); */
+          /* My Implementation */
+          inode_release (&inode->data);
+          /* == My Implementation */
         }
 
-      free (inode); 
+      /* Old Implementation
+      free (inode); */
+      /* My Implementation */
+      kmem_cache_free (inode_cache, inode);
+      /* == My Implementation */
     }
 }
 
@@ -202,7 +409,12 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  /* Old Implementation
+  uint8_t *bounce = NULL; */
+
+  /* My Implementation */
+  rwlock_acquire_read (&inode->rwlock);
+  /* == My Implementation */
 
   while (size > 0) 
     {
@@ -220,23 +432,35 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
+      /* My Implementation */
+      if (sector_idx == SECTOR_NONE)
+        {
+          /* A hole, never written, reads as zeros. */
+          memset (buffer + bytes_read, 0, chunk_size);
+        }
+      else
+      /* == My Implementation */
       if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
         {
           /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+          cache_read (sector_idx, buffer + bytes_read); 
         }
       else 
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
+          /* Old Implementation
           if (bounce == NULL) 
             {
               bounce = malloc (DISK_SECTOR_SIZE);
               if (bounce == NULL)
                 break;
             }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          cache_read (sector_idx, bounce);
+          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size); */
+          /* My Implementation */
+          /* Copy the chunk straight out of the cached sector. */
+          cache_read_at (sector_idx, buffer + bytes_read,
+                         sector_ofs, chunk_size);
+          /* == My Implementation */
         }
       
       /* Advance. */
@@ -244,35 +468,83 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  /* Old Implementation
+  free (bounce); */
+
+  /* My Implementation */
+  /* Sequential reads are likely to continue, fetch the next
+     sector in the background. */
+  if (bytes_read > 0 && ROUND_UP (offset, DISK_SECTOR_SIZE) < inode_length (inode))
+    {
+      disk_sector_t next = byte_to_sector (inode, ROUND_UP (offset, DISK_SECTOR_SIZE));
+      if (next != SECTOR_NONE)
+        cache_readahead (next);
+    }
+  rwlock_release_read (&inode->rwlock);
+  /* == My Implementation */
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk is full or an error occurs.
+   A write past end of file extends the inode; the sectors between
+   the old end of file and OFFSET are left unallocated and read as
+   zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
-
+  /* Old Implementation
+  uint8_t *bounce = NULL; */
+  /* My Implementation */
+  off_t length;
+  bool inode_dirty = false;
+
+  /* Writers are exclusive, the length and the index may change. */
+  rwlock_acquire_write (&inode->rwlock);
+  length = inode_length (inode);
+  /* == My Implementation */
+
+  /* Old Implementation
   if (inode->deny_write_cnt)
-    return 0;
+    return 0; */
+
+  /* My Implementation */
+  if (inode->deny_write_cnt || offset >= INODE_MAX_LENGTH)
+    {
+      rwlock_release_write (&inode->rwlock);
+      return 0;
+    }
+
+  /* Grow the file up to the end of this write. */
+  if (size > INODE_MAX_LENGTH - offset)
+    size = INODE_MAX_LENGTH - offset;
+  if (offset + size > length)
+    length = offset + size;
+  /* == My Implementation */
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Old Implementation
+      disk_sector_t sector_idx = byte_to_sector (inode, offset); */
+      /* My Implementation */
+      size_t index = offset / DISK_SECTOR_SIZE;
+      disk_sector_t sector_idx = index_to_sector (&inode->data, index,
+                                                  false, 0);
+      /* == My Implementation */
       int sector_ofs = offset % DISK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Old Implementation
+      off_t inode_left = inode_length (inode) - offset; */
+      /* My Implementation */
+      off_t inode_left = length - offset;
+      /* == My Implementation */
       int sector_left = DISK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,14 +553,31 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
+      /* My Implementation */
+      /* First write to this sector, allocate it (zeroed). */
+      if (sector_idx == SECTOR_NONE)
+        {
+          /* Place it after the previous sector of the file. */
+          disk_sector_t hint = SECTOR_NONE;
+          if (index > 0)
+            hint = index_to_sector (&inode->data, index - 1, false, 0);
+          if (hint == SECTOR_NONE)
+            hint = inode->sector;
+          sector_idx = index_to_sector (&inode->data, index, true, hint);
+          if (sector_idx == SECTOR_NONE)
+            break;
+          inode_dirty = true;
+        }
+      /* == My Implementation */
+
       if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
         {
-          /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+          /* Write full sector directly to the cache. */
+          cache_write (sector_idx, buffer + bytes_written); 
         }
       else 
         {
-          /* We need a bounce buffer. */
+          /* Old Implementation
           if (bounce == NULL) 
             {
               bounce = malloc (DISK_SECTOR_SIZE);
@@ -296,15 +585,18 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 break;
             }
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
           if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
+            cache_read (sector_idx, bounce);
           else
             memset (bounce, 0, DISK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
+          cache_write (sector_idx, bounce); */
+          /* My Implementation */
+          /* Copy the chunk straight into the cached sector, which
+             keeps the data around it. */
+          cache_write_at (sector_idx, buffer + bytes_written,
+                          sector_ofs, chunk_size);
+          /* == My Implementation */
         }
 
       /* Advance. */
@@ -312,7 +604,20 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+  /* Old Implementation
+  free (bounce); */
+
+  /* My Implementation */
+  /* The file only grows as far as it was actually written. */
+  if (offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      inode_dirty = true;
+    }
+  if (inode_dirty)
+    cache_write (inode->sector, &inode->data);
+  rwlock_release_write (&inode->rwlock);
+  /* == My Implementation */
 
   return bytes_written;
 }
@@ -322,8 +627,14 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  /* My Implementation */
+  rwlock_acquire_write (&inode->rwlock);
+  /* == My Implementation */
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  /* My Implementation */
+  rwlock_release_write (&inode->rwlock);
+  /* == My Implementation */
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +643,15 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  /* My Implementation */
+  rwlock_acquire_write (&inode->rwlock);
+  /* == My Implementation */
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  /* My Implementation */
+  rwlock_release_write (&inode->rwlock);
+  /* == My Implementation */
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +660,114 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* My Implementation */
+/* Returns the sector that holds data sector number IDX of
+   DISK_INODE, walking the direct, indirect and doubly indirect
+   sectors.  If ALLOCATE, the missing data and index sectors are
+   allocated on the way, each one after HINT or the sector
+   allocated before it if possible, and the changes to DISK_INODE
+   itself are left to the caller to write back.
+   Returns SECTOR_NONE if the sector is not allocated, or if
+   ALLOCATE and the disk is full. */
+static disk_sector_t
+index_to_sector (struct inode_disk *disk_inode, size_t idx, bool allocate,
+                 disk_sector_t hint)
+{
+  disk_sector_t table;
+
+  if (idx < DIRECT_CNT)
+    return index_slot (&disk_inode->direct[idx], allocate, &hint);
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    {
+      table = index_slot (&disk_inode->indirect, allocate, &hint);
+      if (table == SECTOR_NONE)
+        return SECTOR_NONE;
+      return index_table (table, idx, allocate, &hint);
+    }
+  idx -= INDIRECT_CNT;
+
+  if (idx < DOUBLY_INDIRECT_CNT)
+    {
+      table = index_slot (&disk_inode->doubly_indirect, allocate, &hint);
+      if (table == SECTOR_NONE)
+        return SECTOR_NONE;
+      table = index_table (table, idx / INDIRECT_CNT, allocate, &hint);
+      if (table == SECTOR_NONE)
+        return SECTOR_NONE;
+      return index_table (table, idx % INDIRECT_CNT, allocate, &hint);
+    }
+
+  return SECTOR_NONE;
+}
+
+/* Returns the sector in *SLOT, first allocating a zeroed sector
+   into it if there is none and ALLOCATE.  The new sector goes
+   right after *HINT if possible and becomes the new *HINT. */
+static disk_sector_t
+index_slot (disk_sector_t *slot, bool allocate, disk_sector_t *hint)
+{
+  static char zeros[DISK_SECTOR_SIZE];
+
+  if (*slot == SECTOR_NONE && allocate
+      && free_map_allocate_near (1, *hint, slot))
+    {
+      cache_write (*slot, zeros);
+      *hint = *slot;
+    }
+  return *slot;
+}
+
+/* Returns entry IDX of the index sector TABLE, first allocating
+   a zeroed sector into it if there is none and ALLOCATE, as
+   index_slot() does with HINT. */
+static disk_sector_t
+index_table (disk_sector_t table, size_t idx, bool allocate,
+             disk_sector_t *hint)
+{
+  disk_sector_t sector;
+
+  ASSERT (idx < INDIRECT_CNT);
+
+  cache_read_at (table, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == SECTOR_NONE && allocate)
+    {
+      index_slot (&sector, true, hint);
+      if (sector != SECTOR_NONE)
+        cache_write_at (table, &sector, idx * sizeof sector, sizeof sector);
+    }
+  return sector;
+}
+
+/* Releases SECTOR, and if LEVEL > 0, the sectors it indexes,
+   LEVEL being 1 for an indirect and 2 for a doubly indirect
+   sector. */
+static void
+index_release (disk_sector_t sector, int level)
+{
+  size_t i;
+
+  if (sector == SECTOR_NONE)
+    return;
+
+  if (level > 0)
+    for (i = 0; i < INDIRECT_CNT; i++)
+      index_release (index_table (sector, i, false, NULL), level - 1);
+  free_map_release (sector, 1);
+}
+
+/* Releases all the data and index sectors of DISK_INODE, but not
+   the sector of DISK_INODE itself. */
+static void
+inode_release (struct inode_disk *disk_inode)
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    index_release (disk_inode->direct[i], 0);
+  index_release (disk_inode->indirect, 1);
+  index_release (disk_inode->doubly_indirect, 2);
+}
+/* == My Implementation */
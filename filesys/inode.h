@@ -9,6 +9,9 @@ struct bitmap;
 
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
+/* My Implementation */
+bool inode_create_allocated (disk_sector_t, off_t); /* create with data sectors allocated */
+/* == My Implementation */
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
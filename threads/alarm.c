@@ -20,8 +20,12 @@ static int64_t prev_ticks;
 
 static bool is_alarm (struct alarm *);
 static void dismiss_alarm (struct alarm *);
+static bool alarm_less (const struct list_elem *, const struct list_elem *, void *aux UNUSED);
 
-/* Initialize the alarm list */
+/* Initialize the alarm list
+ * alarm_list is kept ordered by wake up ticks, so the earliest
+ * deadline is always at the front of the list
+ */
 void
 alarm_init (void)
 {
@@ -52,9 +56,9 @@ set_alarm (int64_t t)
   alrm->ticks = t + timer_ticks (); /* set the tick count to t plus current timer ticks */
   alrm->magic = ALARM_MAGIC;
   
-  /* add to alarm_list, critical section */
+  /* add to alarm_list in deadline order, critical section */
   intr_disable ();
-  list_push_back (&alarm_list, &alrm->elem);
+  list_insert_ordered (&alarm_list, &alrm->elem, alarm_less, NULL);
   
   /* block the thread */
   thread_block ();
@@ -84,20 +88,51 @@ dismiss_alarm (struct alarm *alrm)
   intr_set_level (old_level);
 }
 
+/* Wake up every thread whose alarm is due at NOW
+ * Since alarm_list is ordered, stop at the first alarm in the future,
+ * so we only pay for the alarms that actually expire
+ */
 void
-alarm_check (void)
+alarm_check (int64_t now)
 {
-  struct list_elem *tmp, *next;
   struct alarm *alrm;
   
-  tmp = list_begin (&alarm_list);
+  ASSERT (intr_get_level () == INTR_OFF);
   
-  while (tmp != list_end (&alarm_list))
+  while (!list_empty (&alarm_list))
     { 
-      alrm = list_entry (tmp, struct alarm, elem);
-      next = list_next (tmp);
-      if (alrm->ticks <= timer_ticks ())
-        dismiss_alarm (alrm);
-      tmp = next;
+      alrm = list_entry (list_front (&alarm_list), struct alarm, elem);
+      if (alrm->ticks > now)
+        break;
+      dismiss_alarm (alrm);
     }
 }
+
+/* Returns the tick count of the earliest alarm,
+ * or INT64_MAX if no thread is sleeping
+ */
+int64_t
+alarm_next_ticks (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  
+  if (list_empty (&alarm_list))
+    return INT64_MAX;
+  return list_entry (list_front (&alarm_list), struct alarm, elem)->ticks;
+}
+
+/* Order the alarm_list by wake up ticks,
+ * alarms with the same ticks are kept in FIFO order
+ */
+static bool
+alarm_less (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED)
+{
+  struct alarm *a, *b;
+  
+  ASSERT (lhs != NULL && rhs != NULL);
+  
+  a = list_entry (lhs, struct alarm, elem);
+  b = list_entry (rhs, struct alarm, elem);
+  
+  return (a->ticks < b->ticks);
+}
@@ -24,6 +24,8 @@ void alarm_init (void); /* init the alarm list */
 
 void set_alarm (int64_t); /* set alarm for current thread */
 
-void alarm_check (void); /* check all the alarms in the list, and wake'em up if time's up */
+void alarm_check (int64_t now); /* wake up the threads whose alarms are due at NOW */
+
+int64_t alarm_next_ticks (void); /* the earliest alarm deadline, INT64_MAX if none */
 
 #endif /* THREADS_ALARM_H */
@@ -38,6 +38,14 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+/* My Implementation */
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+#endif
+/* == My Implementation */
 
 /* Amount of physical memory, in 4 kB pages. */
 size_t ram_pages;
@@ -126,6 +134,15 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+  /* My Implementation */
+#ifdef VM
+  page_init ();
+  frame_init ();
+  share_init ();
+  swap_init ();
+#endif
+  /* == My Implementation */
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -260,10 +277,20 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      /* My Implementation */
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      /* == My Implementation */
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
+      /* My Implementation */
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+#endif
+      /* == My Implementation */
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -376,8 +403,12 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop periodic timer ticks while idle.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
 #endif
           );
   power_off ();
@@ -9,8 +9,14 @@
 #include <string.h>
 #include "threads/init.h"
 #include "threads/loader.h"
+/* My Implementation */
+#include "threads/interrupt.h"
+/* == My Implementation */
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+/* My Implementation */
+#include <list.h>
+/* == My Implementation */
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -26,12 +32,58 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
+/* My Implementation */
+/* Free pages are managed by a binary buddy allocator.  The free
+   pages of a pool form blocks of 2**ORDER pages whose page index
+   is a multiple of their size, one free list per order.  An
+   allocation splits the smallest block that is large enough and
+   gives back the pages it does not need; a freed block merges
+   with its buddy, the other half of the block of the next order,
+   as long as that one is free too.  Both take O(log n) steps.
+
+   The used_map only records which pages are allocated, to catch
+   double frees.
+
+   The free lists are accessed with interrupts off, not with a
+   lock, because pages are freed in thread_schedule_tail() where
+   no lock can be taken.  That is cheap since every operation is
+   short. */
+
+/* Number of block orders, the largest block is 2**(ORDER_CNT - 1)
+   pages */
+#define ORDER_CNT 20
+
+/* Marks a page that does not start a free block */
+#define ORDER_NONE UINT8_MAX
+
+/* Single pages each pool keeps when they are freed, handed out
+   again before the free lists are searched. */
+#define PAGE_CACHE_SIZE 32
+
+/* A free block, at the start of its first page. */
+struct free_block
+  {
+    struct list_elem elem;              /* In the list of its order. */
+  };
+/* == My Implementation */
+
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
+    /* Old Implementation
+    struct lock lock; */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    /* My Implementation */
+    uint8_t *orders;                    /* Order of the free block each
+                                           page starts, or ORDER_NONE. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks of each order. */
+
+    /* Recently freed single pages, still marked used in used_map,
+       last freed on top. */
+    void *cache[PAGE_CACHE_SIZE];
+    size_t cache_cnt;
+    /* == My Implementation */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +95,17 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+/* My Implementation */
+static void *pool_take (struct pool *, size_t page_cnt);
+static void pool_give (struct pool *, void *pages, size_t page_cnt);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, int order);
+static void buddy_free_range (struct pool *, size_t page_idx,
+                              size_t page_cnt);
+static void *cache_pop (struct pool *);
+static bool cache_push (struct pool *, void *page);
+static void cache_drain (struct pool *);
+/* == My Implementation */
 
 /* Initializes the page allocator. */
 void
@@ -79,11 +142,13 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
-  size_t page_idx;
+  /* Old Implementation
+  size_t page_idx; */
 
   if (page_cnt == 0)
     return NULL;
 
+  /* Old Implementation
   lock_acquire (&pool->lock);
   page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
   lock_release (&pool->lock);
@@ -91,7 +156,13 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
-    pages = NULL;
+    pages = NULL; */
+  /* My Implementation */
+  /* Single pages come from the cache first */
+  pages = page_cnt == 1 ? cache_pop (pool) : NULL;
+  if (pages == NULL)
+    pages = pool_take (pool, page_cnt);
+  /* == My Implementation */
 
   if (pages != NULL) 
     {
@@ -145,7 +216,15 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 #endif
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  /* My Implementation */
+  if (page_cnt == 1 && cache_push (pool, pages))
+    return;
+  /* == My Implementation */
+  /* Old Implementation
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false); */
+  /* My Implementation */
+  pool_give (pool, pages, page_cnt);
+  /* == My Implementation */
 }
 
 /* Frees the page at PAGE. */
@@ -163,7 +242,14 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   /* We'll put the pool's used_map at its base.
      Calculate the space needed for the bitmap
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* Old Implementation
+  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE); */
+  /* My Implementation */
+  /* The page orders follow the bitmap. */
+  size_t bm_size = ROUND_UP (bitmap_buf_size (page_cnt), sizeof (long));
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+  /* == My Implementation */
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -171,9 +257,24 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
+  /* Old Implementation
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE); */
+  /* My Implementation */
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  bitmap_set_all (p->used_map, true);
+  /* == My Implementation */
   p->base = base + bm_pages * PGSIZE;
+  /* My Implementation */
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, ORDER_NONE, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  p->cache_cnt = 0;
+
+  /* Every page starts out allocated, free them all */
+  pool_give (p, p->base, page_cnt);
+  /* == My Implementation */
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -187,3 +288,190 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* My Implementation */
+/* Takes PAGE_CNT contiguous free pages from POOL, giving the
+   cached pages back to it first if they are missing for a run.
+   Returns a null pointer on failure. */
+static void *
+pool_take (struct pool *pool, size_t page_cnt)
+{
+  enum intr_level old_level;
+  size_t page_idx;
+
+  old_level = intr_disable ();
+  page_idx = buddy_alloc (pool, page_cnt);
+  if (page_idx == BITMAP_ERROR && pool->cache_cnt > 0)
+    {
+      cache_drain (pool);
+      page_idx = buddy_alloc (pool, page_cnt);
+    }
+  intr_set_level (old_level);
+  if (page_idx == BITMAP_ERROR)
+    return NULL;
+
+  ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return pool->base + PGSIZE * page_idx;
+}
+
+/* Gives the PAGE_CNT pages starting at PAGES back to POOL. */
+static void
+pool_give (struct pool *pool, void *pages, size_t page_cnt)
+{
+  enum intr_level old_level;
+  size_t page_idx = pg_no (pages) - pg_no (pool->base);
+
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  buddy_free_range (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
+}
+
+/* Returns the block at PAGE_IDX of POOL. */
+static struct free_block *
+block_at (struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Takes PAGE_CNT contiguous pages from POOL's free lists and
+   returns the index of the first, or BITMAP_ERROR on failure.
+   Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  struct free_block *b;
+  size_t page_idx;
+  int want, order;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Smallest order that holds PAGE_CNT pages */
+  for (want = 0; want < ORDER_CNT && ((size_t) 1 << want) < page_cnt; want++)
+    continue;
+
+  for (order = want; order < ORDER_CNT; order++)
+    if (!list_empty (&pool->free_lists[order]))
+      break;
+  if (order >= ORDER_CNT)
+    return BITMAP_ERROR;
+
+  b = list_entry (list_pop_front (&pool->free_lists[order]),
+                  struct free_block, elem);
+  page_idx = pg_no (b) - pg_no (pool->base);
+  pool->orders[page_idx] = ORDER_NONE;
+
+  /* Split it down to WANT, keeping the lower halves */
+  while (order > want)
+    {
+      order--;
+      buddy_free (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages past PAGE_CNT */
+  buddy_free_range (pool, page_idx + page_cnt,
+                    ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX of POOL, merging
+   it with its buddy as long as that one is free.
+   Interrupts must be off. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (page_idx % ((size_t) 1 << order) == 0);
+
+  while (order < ORDER_CNT - 1)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx + ((size_t) 1 << order) > page_cnt
+          || pool->orders[buddy_idx] != order)
+        break;
+
+      list_remove (&block_at (pool, buddy_idx)->elem);
+      pool->orders[buddy_idx] = ORDER_NONE;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+
+  pool->orders[page_idx] = order;
+  list_push_front (&pool->free_lists[order],
+                   &block_at (pool, page_idx)->elem);
+}
+
+/* Frees the PAGE_CNT pages at PAGE_IDX of POOL as the largest
+   aligned blocks that cover them.
+   Interrupts must be off. */
+static void
+buddy_free_range (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  int order;
+
+  while (page_cnt > 0)
+    {
+      order = page_idx != 0 ? __builtin_ctz (page_idx) : ORDER_CNT - 1;
+      if (order > ORDER_CNT - 1)
+        order = ORDER_CNT - 1;
+      while (((size_t) 1 << order) > page_cnt)
+        order--;
+
+      buddy_free (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Takes the page freed last from POOL's cache,
+   returns a null pointer if the cache is empty. */
+static void *
+cache_pop (struct pool *pool)
+{
+  enum intr_level old_level;
+  void *page = NULL;
+
+  old_level = intr_disable ();
+  if (pool->cache_cnt > 0)
+    page = pool->cache[--pool->cache_cnt];
+  intr_set_level (old_level);
+  return page;
+}
+
+/* Keeps the free PAGE in POOL's cache,
+   returns false if the cache is full. */
+static bool
+cache_push (struct pool *pool, void *page)
+{
+  enum intr_level old_level;
+  bool pushed = false;
+
+  old_level = intr_disable ();
+  if (pool->cache_cnt < PAGE_CACHE_SIZE)
+    {
+      pool->cache[pool->cache_cnt++] = page;
+      pushed = true;
+    }
+  intr_set_level (old_level);
+  return pushed;
+}
+
+/* Gives all the cached pages of POOL back to its free lists.
+   Interrupts must be off. */
+static void
+cache_drain (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->cache_cnt > 0)
+    {
+      void *page = pool->cache[--pool->cache_cnt];
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 0);
+    }
+}
+/* == My Implementation */
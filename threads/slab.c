@@ -0,0 +1,247 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator for the kernel objects that are created and
+ * destroyed all the time
+ *
+ * Unlike malloc(), which rounds a request up to a power of 2, a
+ * cache hands out objects of exactly one size, packed into one page
+ * slabs.  A slab is on the partial, full or empty list of its cache,
+ * allocation takes a partial slab first, so objects stay packed.
+ * The free objects of a slab are chained through an array of
+ * indexes in the slab header instead of through the objects
+ * themselves, so an object keeps what its constructor set up while
+ * it is free, and the owner gives it back in that state.
+ */
+
+/* Magic number for detecting slab corruption */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Objects are aligned to this many bytes */
+#define SLAB_ALIGN sizeof (void *)
+
+/* Ends the free chain of a slab */
+#define SLAB_END UINT16_MAX
+
+/* Empty slabs a cache keeps instead of freeing their pages */
+#define SLAB_EMPTY_MAX 1
+
+/* A cache */
+struct kmem_cache
+  {
+    const char *name;           /* for debugging */
+    size_t obj_size;            /* object size, rounded up to SLAB_ALIGN */
+    size_t obj_cnt;             /* # of objects in a slab */
+    size_t obj_ofs;             /* offset of the first object in a slab */
+    kmem_ctor_func *ctor;       /* null if none */
+
+    struct lock lock;           /* protects the lists and the slabs */
+    struct list partial;        /* slabs with used and free objects */
+    struct list full;           /* slabs with no free object */
+    struct list empty;          /* slabs with no used object */
+    size_t empty_cnt;           /* # of slabs in empty */
+  };
+
+/* A slab, at the start of its page */
+struct slab
+  {
+    unsigned magic;             /* always SLAB_MAGIC */
+    struct kmem_cache *cache;   /* owning cache */
+    size_t used_cnt;            /* # of allocated objects */
+    uint16_t free;              /* first free object, or SLAB_END */
+    struct list_elem elem;      /* in a list of the cache */
+    uint16_t next[];            /* next free object after each free one */
+  };
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void *slab_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Create a cache of SIZE byte objects, CTOR is called on each
+ * object when its slab is created, with the cache lock held, and
+ * may be a null pointer
+ * Meant for init time, so panics if memory runs out
+ */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  size_t cnt;
+
+  ASSERT (size > 0 && size <= PGSIZE / 2);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory for %s", name);
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, SLAB_ALIGN);
+  c->ctor = ctor;
+
+  /* As many objects as fit with their free chain entries */
+  cnt = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t), SLAB_ALIGN)
+         + cnt * c->obj_size > PGSIZE)
+    cnt--;
+  ASSERT (cnt > 0 && cnt < SLAB_END);
+  c->obj_cnt = cnt;
+  c->obj_ofs = ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t),
+                         SLAB_ALIGN);
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->empty_cnt = 0;
+  return c;
+}
+
+/* Returns a free object of C, a null pointer if no page is free */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        {
+          s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+          c->empty_cnt--;
+        }
+      else
+        {
+          s = slab_create (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  ASSERT (s->free != SLAB_END);
+  obj = slab_obj (c, s, s->free);
+  s->free = s->next[s->free];
+  if (++s->used_cnt == c->obj_cnt)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Give OBJ back to C, in the state its constructor left it if C has
+ * one, OBJ may be a null pointer
+ */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - (uint8_t *) s - c->obj_ofs) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->used_cnt > 0);
+  if (s->used_cnt-- == c->obj_cnt)
+    {
+      /* Full to partial */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->next[idx] = s->free;
+  s->free = idx;
+
+  if (s->used_cnt == 0)
+    {
+      list_remove (&s->elem);
+      if (c->empty_cnt < SLAB_EMPTY_MAX)
+        {
+          list_push_front (&c->empty, &s->elem);
+          c->empty_cnt++;
+        }
+      else
+        {
+          s->magic = 0;
+          palloc_free_page (s);
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Returns a new slab of C with all its objects free,
+ * or a null pointer if no page is free
+ */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->used_cnt = 0;
+  s->free = 0;
+  for (i = 0; i < c->obj_cnt; i++)
+    {
+      s->next[i] = i + 1 < c->obj_cnt ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  return s;
+}
+
+/* Returns the slab of OBJ, which must be an object of C */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ASSERT (pg_ofs (obj) >= c->obj_ofs
+          && (pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+  return s;
+}
+
+/* Returns object IDX of slab S of C */
+static void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  ASSERT (idx < c->obj_cnt);
+  return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
@@ -0,0 +1,21 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* A cache of objects of one size */
+struct kmem_cache;
+
+/* Constructor, brings a new object into its free state */
+typedef void kmem_ctor_func (void *obj);
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor_func *); /* panics on failure */
+void *kmem_cache_alloc (struct kmem_cache *); /* null if out of pages */
+void kmem_cache_free (struct kmem_cache *, void *); /* give an object back */
+
+#endif /* threads/slab.h */
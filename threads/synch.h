@@ -49,6 +49,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* My Implementation */
+/* Readers-writer lock, waiting writers hold off new readers so
+ * that they do not starve
+ */
+struct rwlock
+  {
+    struct lock lock;           /* protects the fields below */
+    struct condition can_read;  /* signaled when readers may enter */
+    struct condition can_write; /* signaled when a writer may enter */
+    int readers;                /* # of readers inside */
+    int writers_waiting;        /* # of writers waiting to enter */
+    bool writer;                /* whether a writer is inside */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+/* == My Implementation */
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -24,9 +24,23 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Old Implementation
+static struct list ready_list; */
+
+/* My Implementation */
+/* Ready queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   There is one FIFO queue per priority level, and bit N of
+   ready_levels is set if and only if ready_queues[N] is not
+   empty, so the highest ready priority is a find-first-set. */
+static struct list ready_queues[PRI_MAX - PRI_MIN + 1];
+static uint64_t ready_levels;
+static int ready_count;         /* # of threads in the ready queues. */
+
+#if PRI_MAX - PRI_MIN + 1 > 64
+#error "ready_levels can only track 64 priority levels."
+#endif
+/* == My Implementation */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -77,13 +91,23 @@ static tid_t allocate_tid (void);
 
 /* My Implementation */
 static bool thread_sort_less (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED);
-static bool thread_insert_less_head (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED);
-static bool thread_insert_less_tail (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED);
+
+static void ready_queue_push (struct thread *t, bool head);
+static void ready_queue_remove (struct thread *t);
+static struct thread *ready_queue_pop (void);
+static int ready_queue_top (void);
 
 static void thread_calculate_priority_other (struct thread *curr);
 static void thread_calculate_recent_cpu_other (struct thread *curr);
 
 static int load_avg;
+
+/* Threads whose recent_cpu changed since the last priority
+   calculation, only their priorities need to be recalculated.
+   After recent_cpu is recalculated for every thread once per
+   second, all the priorities have to be recalculated. */
+static struct list changed_list;
+static bool all_changed;
 /* == My Implementation */
 
 
@@ -105,8 +129,21 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
+  /* My Implementation */
+  int i;
+  /* == My Implementation */
+
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  /* Old Implementation
+  list_init (&ready_list); */
+  /* My Implementation */
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i - PRI_MIN]);
+  ready_levels = 0;
+  ready_count = 0;
+  list_init (&changed_list);
+  all_changed = false;
+  /* == My Implementation */
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -159,6 +196,19 @@ thread_tick (void)
     intr_yield_on_return ();
 }
 
+/* My Implementation */
+/* Accounts TICKS timer ticks the CPU spent idle without a timer
+   interrupt, in tickless mode.  Thus, this function runs with
+   interrupts off. */
+void
+thread_tick_idle (int64_t ticks)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  idle_ticks += ticks;
+}
+/* == My Implementation */
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
@@ -242,7 +292,12 @@ thread_create (const char *name, int priority,
 #ifdef USERPROG
   sema_init (&t->wait, 0);
   t->ret_status = RET_STATUS_DEFAULT;
-  list_init (&t->files);
+  t->fds = NULL;
+  t->fd_cnt = 0;
+#ifdef VM
+  t->exec_file = NULL;
+  list_init (&t->mmaps);
+#endif
   list_init (&t->children);
   if (thread_current () != initial_thread)
     list_push_back (&thread_current ()->children, &t->children_elem);
@@ -290,7 +345,7 @@ thread_unblock (struct thread *t)
   /* Old Implementation
   list_push_back (&ready_list, &t->elem); */
   /* My Implementation */
-  list_insert_ordered (&ready_list, &t->elem, thread_insert_less_tail, NULL);
+  ready_queue_push (t, false);
   /* == My Implementation */
   t->status = THREAD_READY;
   intr_set_level (old_level);
@@ -358,7 +413,7 @@ thread_exit (void)
   /* == My Implementation */
   process_exit ();
   /* My Implementation */
-  ASSERT (list_size (&cur->files) == 0);
+  ASSERT (cur->fds == NULL);
   
   if (cur->parent && cur->parent != initial_thread)
     list_remove (&cur->children_elem);
@@ -371,6 +426,10 @@ thread_exit (void)
      when it call schedule_tail(). */
   intr_disable ();
   list_remove (&thread_current()->allelem);
+  /* My Implementation */
+  if (thread_current ()->recent_cpu_changed)
+    list_remove (&thread_current ()->changed_elem);
+  /* == My Implementation */
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -391,7 +450,7 @@ thread_yield (void)
     /* Old Implementation
     list_push_back (&ready_list, &cur->elem); */
     /* My Implementation */
-    list_insert_ordered (&ready_list, &cur->elem, thread_insert_less_tail, NULL);
+    ready_queue_push (cur, false);
     /* == My Implementation */
   cur->status = THREAD_READY;
   schedule ();
@@ -411,7 +470,7 @@ thread_yield_head (struct thread *cur)
     /* Old Implementation
     list_push_back (&ready_list, &cur->elem); */
     /* My Implementation */
-    list_insert_ordered (&ready_list, &cur->elem, thread_insert_less_head, NULL);
+    ready_queue_push (cur, true);
     /* == My Implementation */
   cur->status = THREAD_READY;
   schedule ();
@@ -454,6 +513,15 @@ thread_set_priority (int new_priority)
 void
 thread_set_priority_other (struct thread *curr, int new_priority, bool forced)
 {
+  enum intr_level old_level;
+  bool ready;
+  
+  /* Take a ready thread off the queue of its old priority level */
+  old_level = intr_disable ();
+  ready = curr->status == THREAD_READY;
+  if (ready)
+    ready_queue_remove (curr);
+  
   if (!curr->donated)
     curr->priority = curr->base_priority = new_priority;
   else if (forced)
@@ -466,13 +534,11 @@ thread_set_priority_other (struct thread *curr, int new_priority, bool forced)
   else
     curr->priority = new_priority;
   
-  if (curr->status == THREAD_READY) /* Re-order the ready-list */
-    {
-      list_remove (&curr->elem);
-      list_insert_ordered (&ready_list, &curr->elem, thread_insert_less_tail, NULL);
-    }
-  else if (curr->status == THREAD_RUNNING && list_entry (list_begin (&ready_list), struct thread, elem)->priority > new_priority)
+  if (ready) /* Move to the queue of its new priority level */
+    ready_queue_push (curr, false);
+  else if (curr->status == THREAD_RUNNING && ready_queue_top () > new_priority)
     thread_yield_head (curr);
+  intr_set_level (old_level);
   /*
   else if (curr->status == THREAD_BLOCKED && curr->blocked != NULL)
     {
@@ -535,9 +601,9 @@ thread_calculate_load_avg (void)
   int ready_threads;
   
   if (thread_current () != idle_thread)
-    ready_threads = list_size (&ready_list) + 1;
+    ready_threads = ready_count + 1;
   else
-    ready_threads = list_size (&ready_list);
+    ready_threads = ready_count;
   load_avg = FP_MUL (CONVERT_TO_FP (59) / 60, load_avg) + CONVERT_TO_FP (1) / 60 * ready_threads;
 }
 
@@ -560,6 +626,28 @@ thread_calculate_recent_cpu_for_all (void)
       thread_calculate_recent_cpu_other (t);
       e = list_next (e);
     }
+  
+  all_changed = true;
+}
+
+/* Charge the current tick to the running thread,
+ * called by the timer interrupt handler on every tick
+ */
+void
+thread_increase_recent_cpu (void)
+{
+  struct thread *curr;
+  
+  ASSERT (intr_get_level () == INTR_OFF);
+  
+  curr = thread_current ();
+  curr->recent_cpu = INT_ADD (curr->recent_cpu, 1);
+  
+  if (curr != idle_thread && !curr->recent_cpu_changed)
+    {
+      curr->recent_cpu_changed = true;
+      list_push_back (&changed_list, &curr->changed_elem);
+    }
 }
 
 static void
@@ -587,8 +675,32 @@ thread_calculate_priority_for_all (void)
       thread_calculate_priority_other (t);
       e = list_next (e);
     }
-    
-  sort_thread_list (&ready_list);
+}
+
+/* Recalculate the priorities of the threads whose recent_cpu
+ * changed since the last time, usually only the threads that
+ * ran in the last few ticks, or every thread after the once
+ * per second recent_cpu recalculation
+ */
+void
+thread_calculate_priority_for_changed (void)
+{
+  struct thread *t;
+  
+  ASSERT (intr_get_level () == INTR_OFF);
+  
+  if (all_changed)
+    {
+      thread_calculate_priority_for_all ();
+      all_changed = false;
+    }
+  
+  while (!list_empty (&changed_list))
+    {
+      t = list_entry (list_pop_front (&changed_list), struct thread, changed_elem);
+      t->recent_cpu_changed = false;
+      thread_calculate_priority_other (t);
+    }
 }
 
 void
@@ -600,17 +712,35 @@ thread_calculate_priority (void)
 static void
 thread_calculate_priority_other (struct thread *curr)
 {
+  enum intr_level old_level;
+  int priority;
+  
   ASSERT (is_thread (curr));
   
   if (curr == idle_thread)
     return;
   
-  curr->priority = PRI_MAX - CONVERT_TO_INT_NEAR (curr->recent_cpu / 4) - curr->nice * 2;
+  priority = PRI_MAX - CONVERT_TO_INT_NEAR (curr->recent_cpu / 4) - curr->nice * 2;
+  
+  if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  else if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  
+  if (priority == curr->priority)
+    return;
   
-  if (curr->priority > PRI_MAX)
-    curr->priority = PRI_MAX;
-  else if (curr->priority < PRI_MIN)
-    curr->priority = PRI_MIN;
+  /* A ready thread migrates to the queue of its new level */
+  old_level = intr_disable ();
+  if (curr->status == THREAD_READY)
+    {
+      ready_queue_remove (curr);
+      curr->priority = priority;
+      ready_queue_push (curr, false);
+    }
+  else
+    curr->priority = priority;
+  intr_set_level (old_level);
 }
 
 /* == My Implementation */
@@ -646,8 +776,17 @@ idle (void *idle_started_ UNUSED)
     {
       /* Let someone else run. */
       intr_disable ();
+      /* My Implementation */
+      timer_idle_exit ();
+      /* == My Implementation */
       thread_block ();
 
+      /* My Implementation */
+      /* Nobody else is ready, stop the periodic ticks until the
+         next alarm deadline in tickless mode. */
+      timer_idle_enter ();
+      /* == My Implementation */
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -755,10 +894,17 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 { 
+  /* Old Implementation
   if (list_empty (&ready_list))
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return list_entry (list_pop_front (&ready_list), struct thread, elem); */
+  /* My Implementation */
+  if (ready_count == 0)
+    return idle_thread;
+  else
+    return ready_queue_pop ();
+  /* == My Implementation */
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -873,25 +1019,75 @@ sort_thread_list (struct list *l)
   list_sort (l, thread_sort_less, NULL);
 }
 
-/* same as thread_sort_less but use > instead of >= */
-static bool
-thread_insert_less_head (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED)
+/* Put T into the ready queue of its priority level,
+ * at the head of the level if HEAD, otherwise at the tail
+ * Must be called with interrupts off
+ */
+static void
+ready_queue_push (struct thread *t, bool head)
 {
-  struct thread *a, *b;
+  struct list *queue;
   
-  ASSERT (lhs != NULL && rhs != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->priority >= PRI_MIN && t->priority <= PRI_MAX);
   
-  a = list_entry (lhs, struct thread, elem);
-  b = list_entry (rhs, struct thread, elem);
+  queue = &ready_queues[t->priority - PRI_MIN];
+  if (head)
+    list_push_front (queue, &t->elem);
+  else
+    list_push_back (queue, &t->elem);
+  ready_levels |= (uint64_t) 1 << (t->priority - PRI_MIN);
+  ready_count++;
+}
+
+/* Take T out of the ready queue of its priority level,
+ * T must not have changed its priority since it was pushed
+ * Must be called with interrupts off
+ */
+static void
+ready_queue_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
   
-  return (a->priority >= b->priority);
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority - PRI_MIN]))
+    ready_levels &= ~((uint64_t) 1 << (t->priority - PRI_MIN));
+  ready_count--;
 }
 
-/* same as thread_sort_less */
-static bool
-thread_insert_less_tail (const struct list_elem *lhs, const struct list_elem *rhs, void *aux UNUSED)
+/* Pop the first thread of the highest non-empty level */
+static struct thread *
+ready_queue_pop (void)
 {
-  return thread_sort_less (lhs, rhs, NULL);
+  struct thread *t;
+  int top;
+  
+  top = ready_queue_top ();
+  ASSERT (top >= PRI_MIN);
+  
+  t = list_entry (list_front (&ready_queues[top - PRI_MIN]), struct thread, elem);
+  ready_queue_remove (t);
+  return t;
+}
+
+/* The highest priority among the ready threads,
+ * PRI_MIN - 1 if there is no ready thread
+ */
+static int
+ready_queue_top (void)
+{
+  uint32_t high, low;
+  
+  high = ready_levels >> 32;
+  low = ready_levels;
+  
+  if (high != 0)
+    return PRI_MIN + 63 - __builtin_clz (high);
+  else if (low != 0)
+    return PRI_MIN + 31 - __builtin_clz (low);
+  else
+    return PRI_MIN - 1;
 }
 
 struct thread *
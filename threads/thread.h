@@ -8,6 +8,9 @@
 /* My Implementation */
 #include "threads/alarm.h"
 #include "threads/synch.h"
+#ifdef VM
+#include <hash.h>
+#endif
 /* == My Implementation */
 
 /* States in a thread's life cycle. */
@@ -118,6 +121,8 @@ struct thread
     
     int nice;                           /* nice value of a thread */
     int recent_cpu;                     /* recent cpu usage */
+    bool recent_cpu_changed;            /* whether recent_cpu changed since last priority calculation */
+    struct list_elem changed_elem;      /* in the list of threads whose recent_cpu changed */
     /* == My Implementation */
     
 #ifdef USERPROG
@@ -127,12 +132,19 @@ struct thread
     /* My Implementation */
     struct semaphore wait;              /* semaphore for process_wait */
     int ret_status;                     /* return status */
-    struct list files;                  /* all opened files */
+    struct file **fds;                  /* open files, indexed by fd - 2 */
+    int fd_cnt;                         /* # of slots in fds */
     struct file *self;                  /* the image file on the disk */
     struct thread *parent;              /* parent process */
     struct list children;               /* all children process */
     struct list_elem children_elem;     /* in children list */
     bool exited;                        /* whether the thread is exited or not */
+#ifdef VM
+    struct hash pages;                  /* supplemental page table, see vm/page.c */
+    struct file *exec_file;             /* executable the pages are loaded from */
+    struct list mmaps;                  /* memory mapped files, by id */
+    void *user_esp;                     /* user esp at the last system call */
+#endif
     /* == My Implementation */
 #endif
 
@@ -149,6 +161,9 @@ void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
+/* My Implementation */
+void thread_tick_idle (int64_t);
+/* == My Implementation */
 void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
@@ -178,6 +193,8 @@ void thread_calculate_recent_cpu (void);
 void thread_calculate_priority (void);
 void thread_calculate_recent_cpu_for_all (void);
 void thread_calculate_priority_for_all (void);
+void thread_increase_recent_cpu (void);
+void thread_calculate_priority_for_changed (void);
 struct thread *get_thread_by_tid (tid_t);
 /* == My Implementation */
 
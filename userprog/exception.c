@@ -7,6 +7,10 @@
 /* My Implementation */
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 /* == My Implementation */
 
 /* Number of page faults processed. */
@@ -133,6 +137,7 @@ page_fault (struct intr_frame *f)
   
   /* My Implementation */
   struct thread *t;
+  void *fixup;
   /* == My Implementation */
 
   /* Obtain faulting address, the virtual address that was
@@ -158,6 +163,23 @@ page_fault (struct intr_frame *f)
   
   /* My Implementation */
   t = thread_current ();
+#ifdef VM
+  /* A page not brought in yet, also when touched by the kernel
+     on behalf of a system call, or the stack growing.  In the
+     kernel, f->esp is the kernel stack, so use the user esp saved
+     at the system call. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && (page_load (fault_addr)
+          || page_grow_stack (fault_addr, user ? f->esp : t->user_esp)))
+    return;
+#endif
+  /* A bad address given to a system call, make the probe that
+     touched it fail */
+  if (!user && (fixup = uaccess_fixup ((void *) f->eip)) != NULL)
+    {
+      f->eip = (void (*) (void)) fixup;
+      return;
+    }
   if (not_present || (is_kernel_vaddr (fault_addr) && user))
     sys_exit (-1);
   /* == My Implementation */
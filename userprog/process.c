@@ -20,6 +20,9 @@
 /* My Implementation */
 #include "threads/malloc.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 /* == My Implementation */
 
 static thread_func start_process NO_RETURN;
@@ -246,6 +249,11 @@ process_exit (void)
     sema_up (&cur->wait);
   file_close (cur->self);
   cur->self = NULL;
+#ifdef VM
+  page_table_destroy ();
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+#endif
   cur->exited = true;
   if (cur->parent)
     {
@@ -378,6 +386,13 @@ load (const char *file_name, void (**eip) (void), void **esp)
     goto done;
   process_activate ();
 
+  /* My Implementation */
+#ifdef VM
+  if (!page_table_init ())
+    goto done;
+#endif
+  /* == My Implementation */
+
   /* Open executable file. */
   file = filesys_open (file_name);
   if (file == NULL) 
@@ -469,6 +484,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+  /* My Implementation */
+#ifdef VM
+  /* The pages are loaded from FILE later on, keep it open. */
+  if (success)
+    {
+      t->exec_file = file;
+      return success;
+    }
+#endif
+  /* == My Implementation */
   file_close (file);
   return success;
 }
@@ -553,6 +578,20 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
+      /* My Implementation */
+#ifdef VM
+      /* Only record where the page comes from, page_fault()
+         loads it on first touch. */
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+      ofs += page_read_bytes;
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      upage += PGSIZE;
+      continue;
+#endif
+      /* == My Implementation */
+
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -589,6 +628,20 @@ setup_stack (void **esp)
   uint8_t *kpage;
   bool success = false;
 
+  /* My Implementation */
+#ifdef VM
+  /* The stack page goes through the page table too, so that it
+     can be evicted; it is brought in now for the arguments. */
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  if (page_add_zero (upage, true) && page_load (upage))
+    {
+      *esp = PHYS_BASE;
+      success = true;
+    }
+  return success;
+#endif
+  /* == My Implementation */
+
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
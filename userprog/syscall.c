@@ -7,13 +7,21 @@
 #include "threads/vaddr.h"
 #include "threads/init.h"
 #include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include <list.h>
+#include <string.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/directory.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "devices/input.h"
 #include "threads/synch.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 /* == My Implementation */
 
 static void syscall_handler (struct intr_frame *);
@@ -34,25 +42,40 @@ static int sys_filesize (int fd);
 static int sys_tell (int fd);
 static int sys_seek (int fd, unsigned pos);
 static int sys_remove (const char *file);
+#ifdef VM
+static int sys_mmap (int fd, void *addr);
+static int sys_munmap (int id);
+#endif
 
 static struct file *find_file_by_fd (int fd);
-static struct fd_elem *find_fd_elem_by_fd (int fd);
-static int alloc_fid (void);
-static struct fd_elem *find_fd_elem_by_fd_in_process (int fd);
+static int alloc_fd (struct file *f);
+static bool get_user_name (char name[NAME_MAX + 1], const char *uname);
+static size_t user_chunk (const void *uaddr, unsigned left);
 
 typedef int (*handler) (uint32_t, uint32_t, uint32_t);
 static handler syscall_vec[128];
-static struct lock file_lock;
 
-struct fd_elem
+/* The first fd of a file, 0 and 1 are the console */
+#define FD_BASE 2
+
+/* Slots of a new fd table, which doubles when it is full */
+#define FD_INIT_CNT 16
+
+#ifdef VM
+/* A memory mapped file */
+struct mmap_elem
   {
-    int fd;
-    struct file *file;
-    struct list_elem elem;
-    struct list_elem thread_elem;
+    int id;                     /* mapping id */
+    struct file *file;          /* reopened, so closing the fd keeps it */
+    void *addr;                 /* first page */
+    size_t page_cnt;            /* # of pages */
+    struct list_elem elem;      /* in the mmaps list, ordered by id */
   };
-  
-static struct list file_list;
+
+static struct mmap_elem *find_mmap_by_id (int id);
+
+static struct kmem_cache *mmap_cache;   /* struct mmap_elem */
+#endif
 
 /* == My Implementation */
 
@@ -76,9 +99,12 @@ syscall_init (void)
   syscall_vec[SYS_SEEK] = (handler)sys_seek;
   syscall_vec[SYS_TELL] = (handler)sys_tell;
   syscall_vec[SYS_REMOVE] = (handler)sys_remove;
+#ifdef VM
+  syscall_vec[SYS_MMAP] = (handler)sys_mmap;
+  syscall_vec[SYS_MUNMAP] = (handler)sys_munmap;
   
-  list_init (&file_list);
-  lock_init (&file_lock);
+  mmap_cache = kmem_cache_create ("mmap", sizeof (struct mmap_elem), NULL);
+#endif
   /* == My Implementation */
 }
 
@@ -90,23 +116,23 @@ syscall_handler (struct intr_frame *f /* Old Implementation UNUSED */)
   thread_exit (); */
   /* My Implementation */
   handler h;
-  int *p;
+  int args[4]; /* The number and up to 3 arguments */
   int ret;
   
-  p = f->esp;
+#ifdef VM
+  /* For stack growth on page faults inside the system call */
+  thread_current ()->user_esp = f->esp;
+#endif
   
-  if (!is_user_vaddr (p))
+  if (!copy_from_user (args, f->esp, sizeof args))
     goto terminate;
   
-  if (*p < SYS_HALT || *p > SYS_INUMBER)
+  if (args[0] < SYS_HALT || args[0] > SYS_INUMBER)
     goto terminate;
   
-  h = syscall_vec[*p];
-  
-  if (!(is_user_vaddr (p + 1) && is_user_vaddr (p + 2) && is_user_vaddr (p + 3)))
-    goto terminate;
+  h = syscall_vec[args[0]];
   
-  ret = h (*(p + 1), *(p + 2), *(p + 3));
+  ret = h (args[1], args[2], args[3]);
   
   f->eax = ret;
   
@@ -117,35 +143,59 @@ terminate:
   /* == My Implementation */
 }
 
+/* The buffer is copied in page by page through a kernel page, so
+ * the file system never touches user memory while holding its locks
+ * The console gets up to a page at once, so that a short message
+ * is printed by a single putbuf() and never interleaved
+ */
 static int
 sys_write (int fd, const void *buffer, unsigned length)
 {
-  struct file * f;
-  int ret;
+  struct file *f;
+  uint8_t *kbuf;
+  unsigned done;
+  size_t chunk;
+  int n;
   
-  ret = -1;
-  lock_acquire (&file_lock);
-  if (fd == STDOUT_FILENO) /* stdout */
-    putbuf (buffer, length);
-  else if (fd == STDIN_FILENO) /* stdin */
-    goto done;
-  else if (!is_user_vaddr (buffer) || !is_user_vaddr (buffer + length))
-    {
-      lock_release (&file_lock);
-      sys_exit (-1);
-    }
-  else
+  f = NULL;
+  if (fd == STDIN_FILENO) /* stdin */
+    return -1;
+  if (fd != STDOUT_FILENO)
     {
       f = find_file_by_fd (fd);
       if (!f)
-        goto done;
-        
-      ret = file_write (f, buffer, length);
+        return -1;
     }
-    
-done:
-  lock_release (&file_lock);
-  return ret;
+  
+  kbuf = palloc_get_page (0);
+  if (!kbuf)
+    return -1;
+  for (done = 0; done < length; done += n)
+    {
+      if (f)
+        chunk = user_chunk (buffer + done, length - done);
+      else
+        chunk = length - done < PGSIZE ? length - done : PGSIZE;
+      if (!copy_from_user (kbuf, buffer + done, chunk)) /* bad ptr */
+        {
+          palloc_free_page (kbuf);
+          sys_exit (-1);
+        }
+      if (!f) /* stdout, putbuf() locks the console */
+        {
+          putbuf ((const char *) kbuf, chunk);
+          n = chunk;
+        }
+      else
+        n = file_write (f, kbuf, chunk);
+      if ((size_t) n < chunk) /* end of a file that can't grow */
+        {
+          done += n;
+          break;
+        }
+    }
+  palloc_free_page (kbuf);
+  return done;
 }
 
 int
@@ -153,14 +203,20 @@ sys_exit (int status)
 {
   /* Close all the files */
   struct thread *t;
-  struct list_elem *l;
+  int i;
   
   t = thread_current ();
-  while (!list_empty (&t->files))
-    {
-      l = list_begin (&t->files);
-      sys_close (list_entry (l, struct fd_elem, thread_elem)->fd);
-    }
+#ifdef VM
+  /* Write the mapped files back */
+  while (!list_empty (&t->mmaps))
+    sys_munmap (list_entry (list_front (&t->mmaps),
+                            struct mmap_elem, elem)->id);
+#endif
+  for (i = 0; i < t->fd_cnt; i++)
+    sys_close (i + FD_BASE);
+  free (t->fds);
+  t->fds = NULL;
+  t->fd_cnt = 0;
   
   t->ret_status = status;
   thread_exit ();
@@ -176,39 +232,34 @@ sys_halt (void)
 static int
 sys_create (const char *file, unsigned initial_size)
 {
+  char name[NAME_MAX + 1];
+  
   if (!file)
     return sys_exit (-1);
-  return filesys_create (file, initial_size);
+  if (!get_user_name (name, file))
+    return false;
+  return filesys_create (name, initial_size);
 }
 
 static int
 sys_open (const char *file)
 {
+  char name[NAME_MAX + 1];
   struct file *f;
-  struct fd_elem *fde;
   int ret;
   
   ret = -1; /* Initialize to -1 */
   if (!file) /* file == NULL */
     return -1;
-  if (!is_user_vaddr (file))
-    sys_exit (-1);
-  f = filesys_open (file);
+  if (!get_user_name (name, file))
+    return -1;
+  f = filesys_open (name);
   if (!f) /* Bad file name */
     goto done;
     
-  fde = (struct fd_elem *)malloc (sizeof (struct fd_elem));
-  if (!fde) /* Not enough memory */
-    {
-      file_close (f);
-      goto done;
-    }
-    
-  fde->file = f;
-  fde->fd = alloc_fid ();
-  list_push_back (&file_list, &fde->elem);
-  list_push_back (&thread_current ()->files, &fde->thread_elem);
-  ret = fde->fd;
+  ret = alloc_fd (f);
+  if (ret == -1) /* Not enough memory */
+    file_close (f);
 done:
   return ret;
 }
@@ -216,68 +267,91 @@ done:
 static int
 sys_close(int fd)
 {
-  struct fd_elem *f;
-  int ret;
+  struct thread *t;
+  struct file *f;
   
-  f = find_fd_elem_by_fd_in_process (fd);
+  t = thread_current ();
+  f = find_file_by_fd (fd);
   
   if (!f) /* Bad fd */
     goto done;
-  file_close (f->file);
-  list_remove (&f->elem);
-  list_remove (&f->thread_elem);
-  free (f);
+  file_close (f);
+  t->fds[fd - FD_BASE] = NULL;
   
 done:
   return 0;
 }
 
+/* Like sys_write(), the data goes through a kernel page */
 static int
 sys_read (int fd, void *buffer, unsigned size)
 {
-  struct file * f;
-  unsigned i;
-  int ret;
+  struct file *f;
+  uint8_t *kbuf;
+  unsigned done;
+  size_t chunk, i;
+  int n;
   
-  ret = -1; /* Initialize to zero */
-  lock_acquire (&file_lock);
-  if (fd == STDIN_FILENO) /* stdin */
-    {
-      for (i = 0; i != size; ++i)
-        *(uint8_t *)(buffer + i) = input_getc ();
-      ret = size;
-      goto done;
-    }
-  else if (fd == STDOUT_FILENO) /* stdout */
-      goto done;
-  else if (!is_user_vaddr (buffer) || !is_user_vaddr (buffer + size)) /* bad ptr */
-    {
-      lock_release (&file_lock);
-      sys_exit (-1);
-    }
-  else
+  f = NULL;
+  if (fd == STDOUT_FILENO) /* stdout */
+    return -1;
+  if (fd != STDIN_FILENO)
     {
       f = find_file_by_fd (fd);
       if (!f)
-        goto done;
-      ret = file_read (f, buffer, size);
+        return -1;
     }
-    
-done:    
-  lock_release (&file_lock);
-  return ret;
+  
+  kbuf = palloc_get_page (0);
+  if (!kbuf)
+    return -1;
+  for (done = 0; done < size; done += n)
+    {
+      chunk = user_chunk (buffer + done, size - done);
+      if (!f) /* stdin */
+        {
+          /* Check the chunk is writable before consuming the keys */
+          memset (kbuf, 0, chunk);
+          if (!copy_to_user (buffer + done, kbuf, chunk)) /* bad ptr */
+            {
+              palloc_free_page (kbuf);
+              sys_exit (-1);
+            }
+          for (i = 0; i < chunk; i++)
+            kbuf[i] = input_getc ();
+          n = chunk;
+        }
+      else
+        n = file_read (f, kbuf, chunk);
+      if (!copy_to_user (buffer + done, kbuf, n)) /* bad ptr */
+        {
+          palloc_free_page (kbuf);
+          sys_exit (-1);
+        }
+      if ((size_t) n < chunk) /* end of file */
+        {
+          done += n;
+          break;
+        }
+    }
+  palloc_free_page (kbuf);
+  return done;
 }
 
 static int
 sys_exec (const char *cmd)
 {
-  int ret;
+  char *kcmd;
+  int len, ret;
   
-  if (!cmd || !is_user_vaddr (cmd)) /* bad ptr */
+  if (!cmd) /* bad ptr */
     return -1;
-  lock_acquire (&file_lock);
-  ret = process_execute (cmd);
-  lock_release (&file_lock);
+  kcmd = palloc_get_page (0);
+  if (!kcmd)
+    return -1;
+  len = strncpy_from_user (kcmd, cmd, PGSIZE);
+  ret = len >= 0 && len < PGSIZE ? process_execute (kcmd) : -1;
+  palloc_free_page (kcmd);
   return ret;
 }
 
@@ -287,38 +361,72 @@ sys_wait (pid_t pid)
   return process_wait (pid);
 }
 
+/* Returns the file of FD in the current process, or a null pointer */
 static struct file *
 find_file_by_fd (int fd)
 {
-  struct fd_elem *ret;
+  struct thread *t;
   
-  ret = find_fd_elem_by_fd (fd);
-  if (!ret)
+  t = thread_current ();
+  if (fd < FD_BASE || fd - FD_BASE >= t->fd_cnt)
     return NULL;
-  return ret->file;
+  return t->fds[fd - FD_BASE];
 }
 
-static struct fd_elem *
-find_fd_elem_by_fd (int fd)
+/* Gives F the lowest free fd of the current process, growing the
+ * fd table if it is full
+ * Returns -1 if memory runs out
+ */
+static int
+alloc_fd (struct file *f)
 {
-  struct fd_elem *ret;
-  struct list_elem *l;
+  struct thread *t;
+  struct file **fds;
+  int i, cnt;
   
-  for (l = list_begin (&file_list); l != list_end (&file_list); l = list_next (l))
+  t = thread_current ();
+  for (i = 0; i < t->fd_cnt; i++)
+    if (!t->fds[i])
+      break;
+  
+  if (i == t->fd_cnt) /* Full */
     {
-      ret = list_entry (l, struct fd_elem, elem);
-      if (ret->fd == fd)
-        return ret;
+      cnt = t->fd_cnt ? t->fd_cnt * 2 : FD_INIT_CNT;
+      fds = realloc (t->fds, cnt * sizeof *fds);
+      if (!fds)
+        return -1;
+      memset (fds + t->fd_cnt, 0, (cnt - t->fd_cnt) * sizeof *fds);
+      t->fds = fds;
+      t->fd_cnt = cnt;
     }
-    
-  return NULL;
+  
+  t->fds[i] = f;
+  return i + FD_BASE;
 }
 
-static int
-alloc_fid (void)
+/* Copy the file name UNAME from user memory into NAME,
+ * exits the process if UNAME is a bad pointer
+ * Returns false if the name is too long to name any file
+ */
+static bool
+get_user_name (char name[NAME_MAX + 1], const char *uname)
+{
+  int len;
+  
+  len = strncpy_from_user (name, uname, NAME_MAX + 1);
+  if (len == -1)
+    sys_exit (-1);
+  return len <= NAME_MAX;
+}
+
+/* Bytes of a user buffer at UADDR with LEFT bytes left that are
+ * moved at once, up to the end of its page
+ */
+static size_t
+user_chunk (const void *uaddr, unsigned left)
 {
-  static int fid = 2;
-  return fid++;
+  size_t chunk = PGSIZE - pg_ofs (uaddr);
+  return left < chunk ? left : chunk;
 }
 
 static int
@@ -358,29 +466,111 @@ sys_seek (int fd, unsigned pos)
 static int
 sys_remove (const char *file)
 {
+  char name[NAME_MAX + 1];
+  
   if (!file)
     return false;
-  if (!is_user_vaddr (file))
-    sys_exit (-1);
+  if (!get_user_name (name, file))
+    return false;
     
-  return filesys_remove (file);
+  return filesys_remove (name);
 }
 
-static struct fd_elem *
-find_fd_elem_by_fd_in_process (int fd)
+#ifdef VM
+static int
+sys_mmap (int fd, void *addr)
 {
-  struct fd_elem *ret;
-  struct list_elem *l;
   struct thread *t;
+  struct mmap_elem *m, *other;
+  struct list_elem *l;
+  struct file *f;
+  off_t length;
+  size_t i;
   
   t = thread_current ();
+  f = find_file_by_fd (fd);
+  if (!f || !addr || pg_ofs (addr) != 0)
+    return -1;
+  length = file_length (f);
+  if (length == 0)
+    return -1;
   
-  for (l = list_begin (&t->files); l != list_end (&t->files); l = list_next (l))
+  m = kmem_cache_alloc (mmap_cache);
+  if (!m)
+    return -1;
+  m->file = file_reopen (f);
+  if (!m->file)
     {
-      ret = list_entry (l, struct fd_elem, thread_elem);
-      if (ret->fd == fd)
-        return ret;
+      kmem_cache_free (mmap_cache, m);
+      return -1;
+    }
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  
+  /* The pages must be free user pages */
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      void *upage = addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+      if (!is_user_vaddr (upage) || upage < addr /* wrapped */
+          || page_in_stack_area (upage)
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          while (i-- > 0)
+            page_remove (addr + i * PGSIZE);
+          file_close (m->file);
+          kmem_cache_free (mmap_cache, m);
+          return -1;
+        }
+    }
+  
+  /* Lowest unused id, the list is ordered by id */
+  m->id = 0;
+  for (l = list_begin (&t->mmaps); l != list_end (&t->mmaps); l = list_next (l))
+    {
+      other = list_entry (l, struct mmap_elem, elem);
+      if (other->id != m->id)
+        break;
+      m->id++;
+    }
+  list_insert (l, &m->elem);
+  return m->id;
+}
+
+static int
+sys_munmap (int id)
+{
+  struct mmap_elem *m;
+  size_t i;
+  
+  m = find_mmap_by_id (id);
+  if (!m)
+    return -1;
+  
+  /* Dirty pages are written back as they are removed */
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove (m->addr + i * PGSIZE);
+  file_close (m->file);
+  list_remove (&m->elem);
+  kmem_cache_free (mmap_cache, m);
+  return 0; /* Not used */
+}
+
+static struct mmap_elem *
+find_mmap_by_id (int id)
+{
+  struct thread *t;
+  struct list_elem *l;
+  struct mmap_elem *m;
+  
+  t = thread_current ();
+  for (l = list_begin (&t->mmaps); l != list_end (&t->mmaps); l = list_next (l))
+    {
+      m = list_entry (l, struct mmap_elem, elem);
+      if (m->id == id)
+        return m;
     }
-    
   return NULL;
 }
+#endif
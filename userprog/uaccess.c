@@ -0,0 +1,172 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include <string.h>
+#include "threads/vaddr.h"
+
+/* A probe instruction that may fault on a user address,
+ * and where to resume if it does
+ */
+struct fixup
+  {
+    const void *insn;           /* the faulting instruction */
+    void *resume;               /* returns -1 from the probe */
+  };
+
+/* Returns the byte at UADDR, or -1 if reading it faults */
+int probe_read (const void *uaddr);
+/* Writes BYTE to UADDR, returns 0, or -1 if writing it faults */
+int probe_write (void *uaddr, int byte);
+
+/* The fixup table, ends with a null entry */
+extern const struct fixup uaccess_fixups[];
+
+asm ("\t.text\n"
+     "\t.globl probe_read\n"
+     "\t.type probe_read, @function\n"
+     "probe_read:\n"
+     "\tmovl 4(%esp), %edx\n"
+     "probe_read_insn:\n"
+     "\tmovzbl (%edx), %eax\n"
+     "\tret\n"
+     "probe_read_fixup:\n"
+     "\tmovl $-1, %eax\n"
+     "\tret\n"
+     "\n"
+     "\t.globl probe_write\n"
+     "\t.type probe_write, @function\n"
+     "probe_write:\n"
+     "\tmovl 4(%esp), %edx\n"
+     "\tmovl 8(%esp), %eax\n"
+     "probe_write_insn:\n"
+     "\tmovb %al, (%edx)\n"
+     "\txorl %eax, %eax\n"
+     "\tret\n"
+     "probe_write_fixup:\n"
+     "\tmovl $-1, %eax\n"
+     "\tret\n"
+     "\n"
+     "\t.section .rodata\n"
+     "\t.align 4\n"
+     "\t.globl uaccess_fixups\n"
+     "uaccess_fixups:\n"
+     "\t.long probe_read_insn, probe_read_fixup\n"
+     "\t.long probe_write_insn, probe_write_fixup\n"
+     "\t.long 0, 0\n"
+     "\t.text\n");
+
+/* Whether [UADDR, UADDR + SIZE) lies in user space */
+static bool
+user_range_ok (const void *uaddr, size_t size)
+{
+  return (uintptr_t) uaddr + size >= (uintptr_t) uaddr /* no wrap */
+         && (uintptr_t) uaddr + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Bytes from UADDR to the end of its page, at most SIZE */
+static size_t
+chunk_size (const void *uaddr, size_t size)
+{
+  size_t left = PGSIZE - pg_ofs (uaddr);
+  return size < left ? size : left;
+}
+
+/* Returns where the probe at EIP resumes after a page fault,
+ * or a null pointer if EIP is not a probe
+ * Called by the page fault handler for faults in the kernel
+ */
+void *
+uaccess_fixup (const void *eip)
+{
+  const struct fixup *fx;
+
+  for (fx = uaccess_fixups; fx->insn != NULL; fx++)
+    if (fx->insn == eip)
+      return fx->resume;
+  return NULL;
+}
+
+/* Copy SIZE bytes from user address USRC to DST
+ * Each page is probed once, the page fault handler turns a bad
+ * address into a failed probe instead of killing the kernel, so the
+ * page tables are never walked here
+ * Returns false if some byte is not readable
+ */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  size_t chunk;
+
+  if (!user_range_ok (usrc, size))
+    return false;
+
+  for (; size > 0; size -= chunk)
+    {
+      chunk = chunk_size (usrc, size);
+      if (probe_read (usrc) == -1)
+        return false;
+      memcpy (dst, usrc, chunk);
+      dst += chunk;
+      usrc += chunk;
+    }
+  return true;
+}
+
+/* Copy SIZE bytes from SRC to user address UDST
+ * Returns false if some byte is not writable, the bytes before it
+ * may have been written
+ */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  const uint8_t *s = src;
+  size_t chunk;
+
+  if (!user_range_ok (udst, size))
+    return false;
+
+  for (; size > 0; size -= chunk)
+    {
+      chunk = chunk_size (udst, size);
+      if (probe_write (udst, s[0]) == -1)
+        return false;
+      memcpy (udst + 1, s + 1, chunk - 1);
+      udst += chunk;
+      s += chunk;
+    }
+  return true;
+}
+
+/* Copy the string at user address USRC into DST of SIZE bytes
+ * Returns its length, -1 if it is not readable, or SIZE if it does
+ * not fit with its null terminator, then DST is not terminated
+ */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  const char *end;
+  size_t chunk, len;
+
+  for (len = 0; len < size; len += chunk)
+    {
+      /* Never read kernel memory */
+      if (!is_user_vaddr (usrc))
+        return -1;
+      chunk = chunk_size (usrc, size - len);
+      if (probe_read (usrc) == -1)
+        return -1;
+      end = memchr (usrc, '\0', chunk);
+      if (end != NULL)
+        {
+          memcpy (dst, usrc, end - usrc + 1);
+          return len + (end - usrc);
+        }
+      memcpy (dst, usrc, chunk);
+      dst += chunk;
+      usrc += chunk;
+    }
+  return size;
+}
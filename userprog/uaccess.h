@@ -0,0 +1,17 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool copy_from_user (void *dst, const void *usrc, size_t size); /* false on a bad address */
+bool copy_to_user (void *udst, const void *src, size_t size); /* false on a bad address */
+int strncpy_from_user (char *dst, const char *usrc, size_t size); /* length, -1, or SIZE if too long */
+
+void *uaccess_fixup (const void *eip); /* where a faulting probe resumes */
+
+#endif /* userprog/uaccess.h */
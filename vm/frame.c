@@ -0,0 +1,169 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "vm/frame.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/share.h"
+
+/* All the user frames in use, frame_lock protects the list
+ * and the clock hand, the lock of a frame's page, or share_lock
+ * for a shared frame, protects the frame's contents
+ * A frame's share is set before it enters the table and only
+ * cleared with frame_lock held, so frame_lock protects it too
+ * Lock order: a page's lock, share_lock, then frame_lock
+ */
+static struct list frame_table;
+static struct lock frame_lock;
+static struct list_elem *clock_hand;
+
+static struct frame *frame_evict (void);
+
+static struct kmem_cache *frame_cache;  /* struct frame */
+
+/* Init the frame table */
+void
+frame_init (void)
+{
+  list_init (&frame_table);
+  lock_init (&frame_lock);
+  clock_hand = list_end (&frame_table);
+  frame_cache = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+}
+
+/* Get a frame for P, whose lock must be held, evicting another
+ * page if the user pool is exhausted; the frame is zeroed if ZERO
+ * The frame is for the share S of P unless S is null, it enters
+ * the frame table marked as such, so that the clock algorithm
+ * never takes it for a private page
+ * Returns a null pointer if no frame can be found
+ */
+struct frame *
+frame_alloc (struct page *p, struct share *s, bool zero)
+{
+  struct frame *f;
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  kpage = palloc_get_page (PAL_USER | (zero ? PAL_ZERO : 0));
+  if (kpage != NULL)
+    {
+      f = kmem_cache_alloc (frame_cache);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+    }
+  else
+    {
+      f = frame_evict ();
+      if (f == NULL)
+        return NULL;
+      if (zero)
+        memset (f->kpage, 0, PGSIZE);
+    }
+
+  f->page = p;
+  f->owner = thread_current ();
+  f->share = s;
+  lock_acquire (&frame_lock);
+  list_push_back (&frame_table, &f->elem);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Give F back to the user pool, the lock of its page must be held,
+ * or share_lock if it is shared
+ */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (f->share != NULL || lock_held_by_current_thread (&f->page->lock));
+
+  lock_acquire (&frame_lock);
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->elem);
+  lock_release (&frame_lock);
+
+  palloc_free_page (f->kpage);
+  kmem_cache_free (frame_cache, f);
+}
+
+/* Choose a victim with the clock algorithm, write its page out
+ * and return the frame, taken out of the frame table
+ * Pages whose lock is held, being loaded or freed, are skipped
+ * Returns a null pointer if every frame is busy
+ */
+static struct frame *
+frame_evict (void)
+{
+  struct frame *f, *victim = NULL;
+  size_t i, n;
+
+  lock_acquire (&frame_lock);
+  /* Two rounds, the first one may only clear the accessed bits */
+  n = 2 * list_size (&frame_table);
+  for (i = 0; i < n && victim == NULL; i++)
+    {
+      if (clock_hand == list_end (&frame_table))
+        clock_hand = list_begin (&frame_table);
+      f = list_entry (clock_hand, struct frame, elem);
+      clock_hand = list_next (clock_hand);
+
+      /* A shared frame is read-only, so it is unmapped from every
+         sharer right away, and f->share is cleared */
+      if (f->share != NULL)
+        {
+          if (share_evict (f))
+            {
+              victim = f;
+              list_remove (&f->elem);
+              lock_release (&frame_lock);
+              return victim;
+            }
+          continue;
+        }
+
+      if (lock_held_by_current_thread (&f->page->lock)
+          || !lock_try_acquire (&f->page->lock))
+        continue;
+      /* Only set before the frame enters the table, checked again
+         in case that ever changes */
+      if (f->share != NULL)
+        {
+          lock_release (&f->page->lock);
+          continue;
+        }
+      if (pagedir_is_accessed (f->owner->pagedir, f->page->upage))
+        {
+          pagedir_set_accessed (f->owner->pagedir, f->page->upage, false);
+          lock_release (&f->page->lock);
+          continue;
+        }
+
+      victim = f;
+      list_remove (&f->elem);
+    }
+  lock_release (&frame_lock);
+
+  if (victim == NULL)
+    return NULL;
+
+  /* The page lock keeps the owner from freeing or reloading
+     the page while it is written out. */
+  page_evict (victim->page, victim->owner->pagedir);
+  lock_release (&victim->page->lock);
+  return victim;
+}
@@ -0,0 +1,28 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <list.h>
+#include <stdbool.h>
+
+struct page;
+struct share;
+
+/* A user frame, in the frame table */
+struct frame
+  {
+    void *kpage;                /* kernel virtual address of the frame */
+    struct page *page;          /* the page it holds, unless shared */
+    struct thread *owner;       /* the process of the page, unless shared */
+    struct share *share;        /* the share it holds, or null */
+    struct list_elem elem;      /* in the frame table */
+  };
+
+void frame_init (void); /* init the frame table */
+struct frame *frame_alloc (struct page *, struct share *, bool zero); /* get a frame for a page */
+void frame_free (struct frame *); /* give a frame back */
+
+#endif /* vm/frame.h */
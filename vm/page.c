@@ -0,0 +1,359 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/share.h"
+#include "vm/swap.h"
+
+/* Stack accesses may be this far below esp, PUSHA pushes
+ * 32 bytes before it moves esp
+ */
+#define STACK_SLACK 32
+
+/* 8 MB by default */
+size_t stack_page_limit = 2048;
+
+/* Supplemental page table entries, a free one has its lock
+ * initialized
+ */
+static struct kmem_cache *page_cache;
+
+static struct page *page_add (void *upage, enum page_type, bool writable);
+static bool page_in (struct page *);
+static void page_release (struct page *);
+static void page_write_back (struct page *, uint32_t *pd);
+
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return hash_entry (a, struct page, elem)->upage
+         < hash_entry (b, struct page, elem)->upage;
+}
+
+static void
+page_free (struct hash_elem *e, void *aux UNUSED)
+{
+  page_release (hash_entry (e, struct page, elem));
+}
+
+static void
+page_ctor (void *p)
+{
+  lock_init (&((struct page *) p)->lock);
+}
+
+/* Init the page module */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page), page_ctor);
+}
+
+/* Init the supplemental page table of the current process */
+bool
+page_table_init (void)
+{
+  return hash_init (&thread_current ()->pages, page_hash, page_less, NULL);
+}
+
+/* Free the supplemental page table of the current process,
+ * with the frames and swap slots of its pages
+ * It may never have been initialized if the process failed early
+ */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->pages.buckets != NULL)
+    hash_destroy (&t->pages, page_free);
+}
+
+/* Add UPAGE, which loads READ_BYTES bytes from FILE at OFS and
+ * zeroes the rest of the page on first touch
+ */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  if (read_bytes == 0)
+    return page_add_zero (upage, writable);
+
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+
+  /* Read-only pages of an executable are shared by all the
+     processes running it */
+  if (!writable && !share_add (p))
+    {
+      hash_delete (&thread_current ()->pages, &p->elem);
+      kmem_cache_free (page_cache, p);
+      return false;
+    }
+  return true;
+}
+
+/* Add UPAGE, which is zeroed on first touch */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, PAGE_ZERO, writable) != NULL;
+}
+
+/* Add UPAGE, which maps READ_BYTES bytes of FILE at OFS,
+ * the rest of the page is zeroed and never written back
+ */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs, size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes > 0 && read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_MMAP, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Remove the page of UPAGE from the current process */
+void
+page_remove (void *upage)
+{
+  struct page *p = page_lookup (upage);
+
+  if (p == NULL)
+    return;
+  hash_delete (&thread_current ()->pages, &p->elem);
+  page_release (p);
+}
+
+/* Find the page of UPAGE in the current process,
+ * returns a null pointer if there is none
+ */
+struct page *
+page_lookup (void *upage)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (upage);
+  e = hash_find (&thread_current ()->pages, &key.elem);
+  return e != NULL ? hash_entry (e, struct page, elem) : NULL;
+}
+
+/* Bring in the page of ADDR in the current process
+ * Returns false if ADDR is not in a known page, or if memory or
+ * the disk fails
+ */
+bool
+page_load (void *addr)
+{
+  struct page *p;
+  bool success;
+
+  p = page_lookup (addr);
+  if (p == NULL)
+    return false;
+
+  /* It may have been brought in while waiting for the lock */
+  lock_acquire (&p->lock);
+  success = p->frame != NULL || page_in (p);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Add and bring in a zeroed stack page for ADDR in the current
+ * process, if ADDR looks like a stack access given the user stack
+ * pointer ESP and lies within the stack limit
+ */
+bool
+page_grow_stack (void *addr, void *esp)
+{
+  void *upage = pg_round_down (addr);
+
+  if (!is_user_vaddr (addr) || (uint8_t *) addr < (uint8_t *) esp - STACK_SLACK
+      || !page_in_stack_area (upage))
+    return false;
+  return page_add_zero (upage, true) && page_load (upage);
+}
+
+/* Returns whether UPAGE is in the area reserved for the stack */
+bool
+page_in_stack_area (const void *upage)
+{
+  return (uint8_t *) upage >= (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE
+         && is_user_vaddr (upage);
+}
+
+/* Write P, which the lock of must be held, out of its frame,
+ * PD being the page directory of its owner
+ * Only modified pages are written, mapped ones to their file and
+ * the others to swap; the rest can be read from their file or
+ * zeroed again
+ */
+void
+page_evict (struct page *p, uint32_t *pd)
+{
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame != NULL);
+
+  /* Unmapped first, so the owner faults and waits for the lock
+     instead of modifying the page while it is written out. */
+  pagedir_clear_page (pd, p->upage);
+  if (p->type == PAGE_MMAP)
+    page_write_back (p, pd);
+  else if (pagedir_is_dirty (pd, p->upage))
+    p->swap_slot = swap_out (p->frame->kpage);
+  p->frame = NULL;
+}
+
+/* Bring P, which the lock of must be held, into a new frame
+ * and map it
+ */
+static bool
+page_in (struct page *p)
+{
+  struct thread *t = thread_current ();
+  struct frame *f;
+  bool from_swap = p->swap_slot != SWAP_SLOT_NONE;
+  uint8_t *kpage;
+
+  if (p->share != NULL)
+    return share_load (p);
+
+  f = frame_alloc (p, NULL, !from_swap && p->type == PAGE_ZERO);
+  if (f == NULL)
+    return false;
+  kpage = f->kpage;
+
+  if (from_swap)
+    {
+      swap_in (p->swap_slot, kpage);
+      p->swap_slot = SWAP_SLOT_NONE;
+    }
+  else if (p->type != PAGE_ZERO)
+    {
+      if (file_read_at (p->file, kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (f);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+  if (!pagedir_set_page (t->pagedir, p->upage, kpage, p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+  /* Its swap slot is gone, so it must be written out again */
+  if (from_swap)
+    pagedir_set_dirty (t->pagedir, p->upage, true);
+  p->frame = f;
+  return true;
+}
+
+/* Free P, which is out of the page table of the current process,
+ * with its frame or swap slot, writing it back if it is mapped
+ */
+static void
+page_release (struct page *p)
+{
+  uint32_t *pd = p->pagedir;
+
+  /* Wait for an eviction in progress */
+  lock_acquire (&p->lock);
+  if (p->share != NULL)
+    share_release (p);
+  else if (p->frame != NULL)
+    {
+      pagedir_clear_page (pd, p->upage);
+      if (p->type == PAGE_MMAP)
+        page_write_back (p, pd);
+      frame_free (p->frame);
+    }
+  else if (p->swap_slot != SWAP_SLOT_NONE)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  kmem_cache_free (page_cache, p);
+}
+
+/* Write the mapped page P back to its file if it was modified,
+ * PD being the page directory of its owner
+ */
+static void
+page_write_back (struct page *p, uint32_t *pd)
+{
+  ASSERT (p->type == PAGE_MMAP);
+  ASSERT (p->frame != NULL);
+
+  if (pagedir_is_dirty (pd, p->upage))
+    {
+      file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+      pagedir_set_dirty (pd, p->upage, false);
+    }
+}
+
+/* Add an unloaded page at UPAGE to the current process,
+ * returns a null pointer if it is already there or memory runs out
+ */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->type = type;
+  p->writable = writable;
+  p->frame = NULL;
+  p->swap_slot = SWAP_SLOT_NONE;
+  p->pagedir = thread_current ()->pagedir;
+  p->share = NULL;
+  p->file = NULL;
+  p->ofs = 0;
+  p->read_bytes = 0;
+
+  if (hash_insert (&thread_current ()->pages, &p->elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return NULL;
+    }
+  return p;
+}
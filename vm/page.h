@@ -0,0 +1,66 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct frame;
+struct share;
+
+/* Where the contents of a page come from */
+enum page_type
+  {
+    PAGE_FILE,                  /* read from a file, the rest zeroed */
+    PAGE_ZERO,                  /* all zeros */
+    PAGE_MMAP                   /* mapped file, written back when dirty */
+  };
+
+/* A page of the user address space, in the supplemental page table */
+struct page
+  {
+    void *upage;                /* user virtual address, page aligned */
+    enum page_type type;        /* where the contents come from */
+    bool writable;              /* whether the user may write it */
+    struct lock lock;           /* held while it is loaded, evicted or freed */
+    struct frame *frame;        /* the frame it is in, or null */
+    size_t swap_slot;           /* the swap slot it is in, or SWAP_SLOT_NONE */
+    uint32_t *pagedir;          /* page directory of the owner */
+    struct share *share;        /* shared read-only page, or null */
+    struct list_elem share_elem; /* in the share's pages */
+
+    struct file *file;          /* PAGE_FILE, PAGE_MMAP: file to read from */
+    off_t ofs;                  /* PAGE_FILE, PAGE_MMAP: offset in the file */
+    size_t read_bytes;          /* PAGE_FILE, PAGE_MMAP: bytes to read */
+
+    struct hash_elem elem;      /* in the supplemental page table */
+  };
+
+/* Maximum size of a user stack in pages, set with -sl */
+extern size_t stack_page_limit;
+
+void page_init (void); /* init the page module */
+bool page_table_init (void); /* init the current process's page table */
+void page_table_destroy (void); /* free the current process's page table */
+
+bool page_add_file (void *upage, struct file *, off_t, size_t read_bytes,
+                    bool writable); /* a page to load from a file */
+bool page_add_zero (void *upage, bool writable); /* a zero-filled page */
+bool page_add_mmap (void *upage, struct file *, off_t,
+                    size_t read_bytes); /* a page of a mapped file */
+void page_remove (void *upage); /* drop a page, writing it back if mapped */
+struct page *page_lookup (void *upage); /* find the page of UPAGE */
+bool page_load (void *addr); /* bring in the page of ADDR */
+void page_evict (struct page *, uint32_t *pd); /* write a page out of its frame */
+bool page_grow_stack (void *addr, void *esp); /* add a stack page for ADDR */
+bool page_in_stack_area (const void *upage); /* whether the stack may grow there */
+
+#endif /* vm/page.h */
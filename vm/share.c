@@ -0,0 +1,218 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "vm/share.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* All the shares, by inode and offset, share_lock protects the
+ * table and every share, including the frame and pages fields
+ * of the sharing pages
+ * Lock order: a page's lock, share_lock, then frame_lock
+ */
+static struct hash share_table;
+static struct lock share_lock;
+static struct kmem_cache *share_cache; /* struct share */
+
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct share *s = hash_entry (e, struct share, elem);
+  return hash_bytes (&s->inode, sizeof s->inode) ^ hash_int (s->ofs);
+}
+
+static bool
+share_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  const struct share *x = hash_entry (a, struct share, elem);
+  const struct share *y = hash_entry (b, struct share, elem);
+
+  if (x->inode != y->inode)
+    return x->inode < y->inode;
+  if (x->ofs != y->ofs)
+    return x->ofs < y->ofs;
+  return x->read_bytes < y->read_bytes;
+}
+
+/* Init the share table */
+void
+share_init (void)
+{
+  if (!hash_init (&share_table, share_hash, share_less, NULL))
+    PANIC ("share table creation failed");
+  lock_init (&share_lock);
+  share_cache = kmem_cache_create ("share", sizeof (struct share), NULL);
+}
+
+/* Attach the read-only file page P to the share of its part of
+ * the file, creating the share if P is the first
+ */
+bool
+share_add (struct page *p)
+{
+  struct share key, *s;
+  struct hash_elem *e;
+
+  ASSERT (p->type == PAGE_FILE && !p->writable);
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->ofs;
+  key.read_bytes = p->read_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&share_table, &key.elem);
+  if (e != NULL)
+    s = hash_entry (e, struct share, elem);
+  else
+    {
+      s = kmem_cache_alloc (share_cache);
+      if (s == NULL)
+        {
+          lock_release (&share_lock);
+          return false;
+        }
+      *s = key;
+      s->frame = NULL;
+      list_init (&s->pages);
+      hash_insert (&share_table, &s->elem);
+    }
+  list_push_back (&s->pages, &p->share_elem);
+  p->share = s;
+  lock_release (&share_lock);
+  return true;
+}
+
+/* Map the share of P, whose lock must be held, into P's page
+ * directory, reading it from the file first if no sharer has
+ */
+bool
+share_load (struct page *p)
+{
+  struct share *s = p->share;
+  struct frame *f = NULL;
+  bool success;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  lock_acquire (&share_lock);
+  if (s->frame == NULL)
+    {
+      /* Read without share_lock, evicting may need it */
+      lock_release (&share_lock);
+      f = frame_alloc (p, s, false);
+      if (f == NULL)
+        return false;
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_free (f);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      lock_acquire (&share_lock);
+
+      /* Another sharer may have read it meanwhile */
+      if (s->frame == NULL)
+        s->frame = f;
+      else
+        frame_free (f);
+    }
+
+  success = pagedir_set_page (p->pagedir, p->upage, s->frame->kpage, false);
+  if (success)
+    p->frame = s->frame;
+  lock_release (&share_lock);
+  return success;
+}
+
+/* Detach P, whose lock must be held, from its share, the last
+ * sharer frees the share with its frame
+ */
+void
+share_release (struct page *p)
+{
+  struct share *s = p->share;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  lock_acquire (&share_lock);
+  if (p->frame != NULL)
+    {
+      pagedir_clear_page (p->pagedir, p->upage);
+      p->frame = NULL;
+    }
+  list_remove (&p->share_elem);
+  p->share = NULL;
+
+  if (list_empty (&s->pages))
+    {
+      if (s->frame != NULL)
+        frame_free (s->frame);
+      hash_delete (&share_table, &s->elem);
+      kmem_cache_free (share_cache, s);
+    }
+  lock_release (&share_lock);
+}
+
+/* Unmap the share of frame F from every sharer so that F can be
+ * reused, called by the clock algorithm with the frame table locked
+ * Fails if the share is busy, if F is still being read and is not
+ * the share's frame yet, or if a sharer accessed it recently, in
+ * which case the accessed bits are cleared
+ */
+bool
+share_evict (struct frame *f)
+{
+  struct share *s = f->share;
+  struct list_elem *e;
+  bool accessed = false;
+
+  if (lock_held_by_current_thread (&share_lock)
+      || !lock_try_acquire (&share_lock))
+    return false;
+  if (s->frame != f)
+    {
+      lock_release (&share_lock);
+      return false;
+    }
+
+  for (e = list_begin (&s->pages); e != list_end (&s->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, share_elem);
+      if (p->frame != NULL && pagedir_is_accessed (p->pagedir, p->upage))
+        {
+          pagedir_set_accessed (p->pagedir, p->upage, false);
+          accessed = true;
+        }
+    }
+
+  if (!accessed)
+    {
+      /* Read-only and clean, nothing to write back */
+      for (e = list_begin (&s->pages); e != list_end (&s->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, share_elem);
+          if (p->frame != NULL)
+            {
+              pagedir_clear_page (p->pagedir, p->upage);
+              p->frame = NULL;
+            }
+        }
+      f->share = NULL;
+      s->frame = NULL;
+    }
+  lock_release (&share_lock);
+  return !accessed;
+}
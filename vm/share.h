@@ -0,0 +1,35 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef VM_SHARE_H
+#define VM_SHARE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct page;
+
+/* A read-only executable page, shared by every process that
+ * maps the same part of the same inode
+ */
+struct share
+  {
+    struct inode *inode;        /* the executable */
+    off_t ofs;                  /* offset of the page in it */
+    size_t read_bytes;          /* bytes read from it, the rest is zeros */
+    struct frame *frame;        /* the frame it is in, or null */
+    struct list pages;          /* the struct page of every sharer */
+    struct hash_elem elem;      /* in the share table */
+  };
+
+void share_init (void); /* init the share table */
+bool share_add (struct page *); /* attach a page to its share */
+bool share_load (struct page *); /* map a page's share, reading it if needed */
+void share_release (struct page *); /* detach a page from its share */
+bool share_evict (struct frame *); /* unmap a shared frame everywhere */
+
+#endif /* vm/share.h */
@@ -0,0 +1,72 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "devices/disk.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Sectors in a swap slot */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+static struct disk *swap_disk;   /* hd1:1, or null if there is none */
+static struct bitmap *swap_map;  /* one bit per slot, true if in use */
+static struct lock swap_lock;    /* protects swap_map */
+
+/* Find the swap disk and init the slot map,
+ * without a swap disk nothing can be swapped out
+ */
+void
+swap_init (void)
+{
+  size_t slots = 0;
+
+  lock_init (&swap_lock);
+  swap_disk = disk_get (1, 1);
+  if (swap_disk != NULL)
+    slots = disk_size (swap_disk) / SECTORS_PER_SLOT;
+  swap_map = bitmap_create (slots);
+  if (swap_map == NULL)
+    PANIC ("swap map creation failed");
+}
+
+/* Write the page KPAGE to a free slot and return the slot */
+size_t
+swap_out (const void *kpage)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    PANIC ("swap is full");
+
+  disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT, kpage,
+                       SECTORS_PER_SLOT);
+  return slot;
+}
+
+/* Read SLOT into the page KPAGE and free the slot */
+void
+swap_in (size_t slot, void *kpage)
+{
+  ASSERT (bitmap_test (swap_map, slot));
+
+  disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT, kpage,
+                      SECTORS_PER_SLOT);
+  swap_free (slot);
+}
+
+/* Free SLOT */
+void
+swap_free (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  lock_release (&swap_lock);
+}
@@ -0,0 +1,18 @@
+/* This file is fully designed and created by Christopher Xu
+ * See README at root directory for details
+ */
+
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+/* A page that is not in swap */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
+void swap_init (void); /* find the swap disk and init the slot map */
+size_t swap_out (const void *kpage); /* write a page to a free slot */
+void swap_in (size_t slot, void *kpage); /* read a page back and free its slot */
+void swap_free (size_t slot); /* drop a slot without reading it */
+
+#endif /* vm/swap.h */